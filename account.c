@@ -0,0 +1,217 @@
+#include "account.h"
+static const long AGE_LIMITS[AGE_BUCKETS - 1] = { 86400L, 7 * 86400L, 30 * 86400L, 90 * 86400L, 365 * 86400L, 3 * 365 * 86400L };
+static const char* AGE_LABELS[AGE_BUCKETS] = {
+    "< 1 day", "1 day - 1 week", "1 week - 1 month", "1 - 3 months", "3 months - 1 year", "1 - 3 years", ">= 3 years",
+};
+
+void init_accounting(Accounting* a, GroupKey group_by, bool sizes, bool ages, time_t now){
+    a->enabled      = group_by != GROUP_NONE || sizes || ages;
+    a->group_by     = group_by;
+    a->sizes        = sizes;
+    a->ages         = ages;
+    a->now          = now;
+    a->groups       = (GroupMap){ NULL, 0, 0 };
+    memset(a->size_hist, 0, sizeof(a->size_hist));
+    memset(a->age_hist, 0, sizeof(a->age_hist));
+}
+
+void destroy_accounting(Accounting* a){
+    for(size_t i = 0; i < a->groups.cap; i++) free(a->groups.slots[i].name);
+    free(a->groups.slots);
+    a->groups = (GroupMap){ NULL, 0, 0 };
+}
+
+static uint64_t mix(uint64_t x){
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hash_name(const char* name, size_t len){
+    uint64_t h = 14695981039346656037ULL;
+    for(size_t i = 0; i < len; i++){
+        h ^= (unsigned char)name[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static GroupSlot* find_slot(GroupMap* m, uint64_t key, const char* name, size_t len){
+    size_t mask = m->cap - 1;
+    for(size_t i = mix(key) & mask;; i = (i + 1) & mask){
+        GroupSlot* s = &m->slots[i];
+        if(s->entries == 0) return s;
+        if(s->key != key) continue;
+        if(name == NULL || (strncmp(s->name, name, len) == 0 && s->name[len] == '\0')) return s;
+    }
+}
+
+static void grow_map(GroupMap* m){
+    GroupMap old = *m;
+    m->cap  = old.cap == 0 ? GROUP_MAP_INIT : old.cap * 2;
+    m->slots = calloc(m->cap, sizeof(GroupSlot));
+    if(m->slots == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < old.cap; i++){
+        GroupSlot* s = &old.slots[i];
+        if(s->entries != 0) *find_slot(m, s->key, s->name, s->name == NULL ? 0 : strlen(s->name)) = *s;
+    }
+    free(old.slots);
+}
+
+static void add_group(GroupMap* m, uint64_t key, const char* name, size_t len, long entries, long blocks){
+    if((m->n + 1) * 4 > m->cap * 3) grow_map(m);
+    GroupSlot* s = find_slot(m, key, name, len);
+    if(s->entries == 0){
+        s->key  = key;
+        s->name = NULL;
+        if(name != NULL && (s->name = strndup(name, len)) == NULL){
+            perror("strndup");
+            exit(EXIT_FAILURE);
+        }
+        m->n++;
+    }
+    s->entries  += entries;
+    s->blocks   += blocks;
+}
+
+static const char* extension(const char* name, mode_t mode, size_t* len){
+    const char* base = strrchr(name, '/');
+    base = base == NULL ? name : base + 1;
+    const char* dot = S_ISREG(mode) ? strrchr(base, '.') : NULL;
+    //Hidden files without a further dot have no extension.
+    if(dot == NULL || dot == base || dot[1] == '\0'){
+        *len = 0;
+        return "";
+    }
+    *len = strlen(dot + 1);
+    return dot + 1;
+}
+
+void account_entry(Accounting* a, const char* name, mode_t mode, uid_t uid, gid_t gid, off_t size, time_t mtime, long blocks){
+    size_t len;
+    const char* ext;
+    switch (a->group_by) {
+        case GROUP_UID:
+            add_group(&a->groups, uid, NULL, 0, 1, blocks);
+            break;
+        case GROUP_GID:
+            add_group(&a->groups, gid, NULL, 0, 1, blocks);
+            break;
+        case GROUP_EXT:
+            ext = extension(name, mode, &len);
+            add_group(&a->groups, hash_name(ext, len), ext, len, 1, blocks);
+            break;
+        case GROUP_NONE:
+            break;
+    }
+    if(!S_ISREG(mode)) return;
+
+    if(a->sizes){
+        int b = size <= 0 ? 0 : 64 - __builtin_clzl((unsigned long)size);
+        if(b >= SIZE_BUCKETS) b = SIZE_BUCKETS - 1;
+        a->size_hist[b].files++;
+        a->size_hist[b].blocks += blocks;
+    }
+    if(a->ages){
+        long age = a->now - mtime;
+        int b = 0;
+        while(b < AGE_BUCKETS - 1 && age >= AGE_LIMITS[b]) b++;
+        a->age_hist[b].files++;
+        a->age_hist[b].blocks += blocks;
+    }
+}
+
+void merge_accounting(Accounting* total, const Accounting* a){
+    for(size_t i = 0; i < a->groups.cap; i++){
+        const GroupSlot* s = &a->groups.slots[i];
+        if(s->entries == 0) continue;
+        add_group(&total->groups, s->key, s->name, s->name == NULL ? 0 : strlen(s->name), s->entries, s->blocks);
+    }
+    for(int b = 0; b < SIZE_BUCKETS; b++){
+        total->size_hist[b].files   += a->size_hist[b].files;
+        total->size_hist[b].blocks  += a->size_hist[b].blocks;
+    }
+    for(int b = 0; b < AGE_BUCKETS; b++){
+        total->age_hist[b].files    += a->age_hist[b].files;
+        total->age_hist[b].blocks   += a->age_hist[b].blocks;
+    }
+}
+
+static int compare_groups(const void* a, const void* b){
+    const GroupSlot* ga = *(const GroupSlot* const*)a;
+    const GroupSlot* gb = *(const GroupSlot* const*)b;
+    if(ga->blocks != gb->blocks) return ga->blocks < gb->blocks ? 1 : -1;
+    if(ga->entries != gb->entries) return ga->entries < gb->entries ? 1 : -1;
+    if(ga->name != NULL) return strcmp(ga->name, gb->name);
+    return ga->key < gb->key ? -1 : ga->key > gb->key;
+}
+
+static void print_group(FILE* out, GroupKey group_by, const GroupSlot* s){
+    const char* label = NULL;
+    if(group_by == GROUP_UID){
+        struct passwd* pw = getpwuid(s->key);
+        if(pw != NULL) label = pw->pw_name;
+    } else if(group_by == GROUP_GID){
+        struct group* gr = getgrgid(s->key);
+        if(gr != NULL) label = gr->gr_name;
+    } else {
+        label = s->name[0] == '\0' ? "-" : s->name;
+    }
+
+    if(label != NULL) fprintf(out, "%ld\t%ld\t%s\n", s->blocks, s->entries, label);
+    else fprintf(out, "%ld\t%ld\t%lu\n", s->blocks, s->entries, (unsigned long)s->key);
+}
+
+static void format_bytes(char* buf, size_t n, unsigned long bytes){
+    static const char units[] = "BKMGTP";
+    int unit = 0;
+    while(bytes >= 1024 && bytes % 1024 == 0 && units[unit + 1] != '\0'){
+        bytes /= 1024;
+        unit++;
+    }
+    snprintf(buf, n, "%lu%c", bytes, units[unit]);
+}
+
+void print_accounting(FILE* out, const Accounting* a){
+    static const char* KEYS[] = { "", "uid", "gid", "ext" };
+    if(a->group_by != GROUP_NONE){
+        fprintf(out, "usage by %s:\n", KEYS[a->group_by]);
+        const GroupSlot** sorted = malloc((a->groups.n + 1) * sizeof(GroupSlot*));
+        if(sorted == NULL){
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        size_t n = 0;
+        for(size_t i = 0; i < a->groups.cap; i++){
+            if(a->groups.slots[i].entries != 0) sorted[n++] = &a->groups.slots[i];
+        }
+        qsort(sorted, n, sizeof(GroupSlot*), compare_groups);
+        for(size_t i = 0; i < n; i++) print_group(out, a->group_by, sorted[i]);
+        free(sorted);
+    }
+
+    if(a->sizes){
+        fprintf(out, "file sizes:\n");
+        for(int b = 0; b < SIZE_BUCKETS; b++){
+            if(a->size_hist[b].files == 0) continue;
+            char lo[16], hi[16];
+            format_bytes(lo, sizeof(lo), b == 0 ? 0 : 1UL << (b - 1));
+            format_bytes(hi, sizeof(hi), 1UL << b);
+            if(b == 0) fprintf(out, "%ld\t%ld\t0B\n", a->size_hist[b].blocks, a->size_hist[b].files);
+            else if(b == SIZE_BUCKETS - 1) fprintf(out, "%ld\t%ld\t>= %s\n", a->size_hist[b].blocks, a->size_hist[b].files, lo);
+            else fprintf(out, "%ld\t%ld\t%s - %s\n", a->size_hist[b].blocks, a->size_hist[b].files, lo, hi);
+        }
+    }
+
+    if(a->ages){
+        fprintf(out, "file ages:\n");
+        for(int b = 0; b < AGE_BUCKETS; b++){
+            if(a->age_hist[b].files == 0) continue;
+            fprintf(out, "%ld\t%ld\t%s\n", a->age_hist[b].blocks, a->age_hist[b].files, AGE_LABELS[b]);
+        }
+    }
+}
@@ -0,0 +1,142 @@
+/**
+ *
+ * This file defines the usage accounting behind `--group-by` and `--histogram`.
+ * Every worker owns one `Accounting` and adds every entry it sizes to it, using
+ * the status `mdu` already read for the entry, so accounting costs no extra
+ * system call. The workers' accounting is merged once they are joined, no map is
+ * ever shared between threads.
+ *
+ * `--group-by` splits usage by owner, group or file extension in an open
+ * addressing hash map. Owners and groups are keyed by their id, extensions by a
+ * hash of the name with the name itself kept for comparison. Only regular files
+ * have an extension, every other entry and files without one are grouped under
+ * the empty extension.
+ *
+ * `--histogram=size` counts regular files in power of two buckets of their
+ * apparent size, bucket `b` holding sizes from 2^(b-1) to 2^b - 1 bytes and the
+ * last one everything larger. `--histogram=age` counts them by the age of their
+ * modification time at the start of the scan.
+ *
+ * Every entry counts its blocks as they are counted in the totals, so a further
+ * link to a counted inode adds one entry and no blocks.
+ *
+ * @file account.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Per-worker usage split by owner, group, extension, size and age.
+ */
+
+#ifndef ACCOUNT_H
+#define ACCOUNT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <pwd.h>
+#include <grp.h>
+
+#define SIZE_BUCKETS    42
+#define AGE_BUCKETS     7
+#define GROUP_MAP_INIT  64
+
+typedef enum {
+    GROUP_NONE,
+    GROUP_UID,
+    GROUP_GID,
+    GROUP_EXT,
+} GroupKey;
+
+/**
+ * @note A slot is free while `entries` is 0. `name` is the extension for
+ *       `GROUP_EXT`, `NULL` otherwise, `key` is the id or the hash of `name`.
+ */
+typedef struct {
+    uint64_t key;
+    char* name;
+    long entries;
+    long blocks;
+} GroupSlot;
+
+typedef struct {
+    GroupSlot* slots;
+    size_t cap;
+    size_t n;
+} GroupMap;
+
+typedef struct {
+    long files;
+    long blocks;
+} Bucket;
+
+/**
+ * @note `enabled` is set if any grouping or histogram is collected, `now` is the
+ *       time ages are measured from.
+ */
+typedef struct {
+    bool enabled;
+    GroupKey group_by;
+    bool sizes;
+    bool ages;
+    time_t now;
+    GroupMap groups;
+    Bucket size_hist[SIZE_BUCKETS];
+    Bucket age_hist[AGE_BUCKETS];
+} Accounting;
+
+/**
+ * @brief Initializes empty accounting.
+ *
+ * @param a         Pointer to the accounting.
+ * @param group_by  What usage is grouped by, `GROUP_NONE` for nothing.
+ * @param sizes     Whether the size histogram is collected.
+ * @param ages      Whether the age histogram is collected.
+ * @param now       Time ages are measured from.
+ */
+void init_accounting(Accounting* a, GroupKey group_by, bool sizes, bool ages, time_t now);
+
+/**
+ * @brief Frees the group map and the extensions it holds.
+ *
+ * @param a Pointer to the accounting.
+ */
+void destroy_accounting(Accounting* a);
+
+/**
+ * @brief Adds a sized entry.
+ *
+ * @param a         Pointer to the worker's accounting, enabled.
+ * @param name      Name of the entry, for its extension.
+ * @param mode      File type and mode of the entry.
+ * @param uid       Owner of the entry.
+ * @param gid       Group of the entry.
+ * @param size      Apparent size of the entry in bytes.
+ * @param mtime     Modification time of the entry.
+ * @param blocks    Blocks the entry adds to the totals.
+ */
+void account_entry(Accounting* a, const char* name, mode_t mode, uid_t uid, gid_t gid, off_t size, time_t mtime, long blocks);
+
+/**
+ * @brief Adds one worker's accounting to a total.
+ *
+ * @param total Pointer to the total, initialized with the same options.
+ * @param a     Pointer to the worker's accounting.
+ */
+void merge_accounting(Accounting* total, const Accounting* a);
+
+/**
+ * @brief Prints the groups, largest first, and the non-empty histogram buckets.
+ *
+ * Every line holds the blocks, the number of entries and the group or bucket,
+ * separated by tabs. Owners and groups are printed by name where they have one.
+ *
+ * @param out   The stream to print to.
+ * @param a     Pointer to the merged accounting.
+ */
+void print_accounting(FILE* out, const Accounting* a);
+
+#endif
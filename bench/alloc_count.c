@@ -0,0 +1,65 @@
+/**
+ *
+ * Preloadable library counting heap allocations of the program it is loaded into.
+ * `malloc`, `calloc`, `realloc` and `free` are forwarded to glibc and counted, at
+ * exit the counts and the peak resident set size are written as one CSV line to
+ * the file named by `MDU_ALLOC_REPORT`, or to stderr if it is unset.
+ *
+ * To run:
+ *   make bench/alloc_count.so
+ *   LD_PRELOAD=./bench/alloc_count.so ./mdu -j4 /usr
+ *
+ * Output: mallocs,callocs,reallocs,frees,peak_rss_kb
+ *
+ * @file alloc_count.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Allocation counter for the allocation report.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <sys/resource.h>
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* p, size_t size);
+extern void __libc_free(void* p);
+
+static atomic_long mallocs;
+static atomic_long callocs;
+static atomic_long reallocs;
+static atomic_long frees;
+
+void* malloc(size_t size){
+    atomic_fetch_add_explicit(&mallocs, 1, memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size){
+    atomic_fetch_add_explicit(&callocs, 1, memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size){
+    atomic_fetch_add_explicit(&reallocs, 1, memory_order_relaxed);
+    return __libc_realloc(p, size);
+}
+
+void free(void* p){
+    if(p != NULL) atomic_fetch_add_explicit(&frees, 1, memory_order_relaxed);
+    __libc_free(p);
+}
+
+__attribute__((destructor)) static void report(void){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    const char* path = getenv("MDU_ALLOC_REPORT");
+    FILE* out = path == NULL ? stderr : fopen(path, "a");
+    if(out == NULL) return;
+    fprintf(out, "%ld,%ld,%ld,%ld,%ld\n", atomic_load(&mallocs), atomic_load(&callocs),
+        atomic_load(&reallocs), atomic_load(&frees), usage.ru_maxrss);
+    if(out != stderr) fclose(out);
+}
@@ -0,0 +1,53 @@
+#!/bin/bash
+# Compares heap allocations and peak RSS of ./mdu with a baseline build.
+#
+# Usage: bench/alloc_report.sh [-j threads] [-e engine] BASE path ...
+#   BASE is either an mdu binary or a git revision, which is built in a
+#   temporary worktree. Every path is scanned once by each binary with
+#   bench/alloc_count.so preloaded.
+#
+# Output is CSV: binary,path,mallocs,callocs,reallocs,frees,peak_rss_kb
+
+set -e
+threads=4
+engine=thread
+while getopts "j:e:" opt; do
+    case $opt in
+        j) threads=$OPTARG ;;
+        e) engine=$OPTARG ;;
+        *) echo "Usage: $0 [-j threads] [-e engine] BASE path ..." >&2; exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 [-j threads] [-e engine] BASE path ..." >&2
+    exit 1
+fi
+
+base=$1
+shift
+root=$(cd "$(dirname "$0")/.." && pwd)
+make -s -C "$root" mdu bench/alloc_count.so
+
+tmp=$(mktemp -d)
+trap 'git -C "$root" worktree remove --force "$tmp/base" >/dev/null 2>&1 || true; rm -rf "$tmp"' EXIT
+
+if [ -x "$base" ] && [ -f "$base" ]; then
+    base_bin=$(cd "$(dirname "$base")" && pwd)/$(basename "$base")
+else
+    git -C "$root" worktree add --detach "$tmp/base" "$base" >/dev/null 2>&1
+    make -s -C "$tmp/base" mdu >/dev/null
+    base_bin=$tmp/base/mdu
+fi
+
+echo "binary,path,mallocs,callocs,reallocs,frees,peak_rss_kb"
+for path in "$@"; do
+    for bin in "$base_bin" "$root/mdu"; do
+        rm -f "$tmp/report"
+        MDU_ALLOC_REPORT=$tmp/report LD_PRELOAD=$root/bench/alloc_count.so \
+            "$bin" -j "$threads" --engine="$engine" "$path" >/dev/null 2>&1 || true
+        name=current
+        [ "$bin" = "$base_bin" ] && name=base
+        echo "$name,$path,$(tail -n 1 "$tmp/report")"
+    done
+done
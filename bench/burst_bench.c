@@ -0,0 +1,232 @@
+/**
+ *
+ * Benchmark of idle parking and termination on trees with bursty parallelism.
+ * The tree is a spine of `-s` entries, each spine entry spinning for `-W`
+ * iterations before pushing the next spine entry and a burst of `-b` leaves that
+ * spin for `-w` iterations each. Parallelism therefore alternates between one
+ * runnable entry and a burst, and workers go idle and are woken again at every
+ * spine step.
+ *
+ * The legacy variant reproduces the original protocol: a shared semaphore posted
+ * for every entry, `push_q`/`pop_q` under the queue mutex and termination through
+ * an active thread counter combined with `is_queue_empty`. The scheduler variant
+ * uses the work-stealing scheduler with its futex eventcount.
+ *
+ * Both wall time and process CPU time are reported. CPU time beyond the work
+ * itself is spent by idle workers spinning, waking without work or contending on
+ * locks.
+ *
+ * To run:
+ *   make bench-burst
+ *   ./bench/burst_bench [-s spine] [-b burst] [-w leaf_work] [-W spine_work] [-t max_threads] [-r repeats]
+ *
+ * Output is CSV on stdout:
+ *   threads,legacy_wall,legacy_cpu,sched_wall,sched_cpu
+ *
+ * @file burst_bench.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Idle parking benchmark on bursty trees.
+ */
+
+#include "queue.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#define LEAF -1
+
+typedef struct {
+    int spine;
+    int burst;
+    long leaf_work;
+    long spine_work;
+} BurstShape;
+
+typedef struct {
+    const BurstShape* shape;
+    Queue* q;
+    sem_t* sem;
+    atomic_int* active_threads;
+    Scheduler* sched;
+    atomic_long* visited;
+    int id;
+    int nthreads;
+} BenchArgs;
+
+static volatile long sink;
+
+static void spin(long work){
+    long acc = 0;
+    for(long i = 0; i < work; i++) acc += i;
+    sink = acc;
+}
+
+//Spins for the entry and schedules its children through `push`.
+static void visit(const BurstShape* shape, int kind, void (*push)(BenchArgs*, int), BenchArgs* args){
+    if(kind == LEAF){
+        spin(shape->leaf_work);
+        return;
+    }
+    spin(shape->spine_work);
+    if(kind + 1 < shape->spine) push(args, kind + 1);
+    for(int i = 0; i < shape->burst; i++) push(args, LEAF);
+}
+
+static void legacy_push(BenchArgs* args, int kind){
+    push_q(args->q, "entry", args->sem, kind);
+}
+
+static void sched_bench_push(BenchArgs* args, int kind){
+    sched_push(args->sched, args->id, create_entry(NULL, NULL, "entry", kind));
+}
+
+static void* legacy_thread(void* arg){
+    BenchArgs* args = (BenchArgs*)arg;
+    int finished = 0;
+    long visited = 0;
+    char* path = NULL;
+    while(1){
+        atomic_fetch_add(args->active_threads, -1);
+        if (is_queue_empty(args->q) && *args->active_threads == 0) {
+            finished = 1;
+            for(int i = 0; i < args->nthreads; i++) sem_post(args->sem);
+        }
+
+        sem_wait(args->sem);
+        if(finished) break;
+        atomic_fetch_add(args->active_threads, +1);
+
+        int kind = 0;
+        free(path);
+        if((path = pop_q(args->q, &kind)) == NULL) continue;
+
+        visited++;
+        visit(args->shape, kind, legacy_push, args);
+    }
+    free(path);
+    atomic_fetch_add(args->visited, visited);
+    return NULL;
+}
+
+static void* sched_thread(void* arg){
+    BenchArgs* args = (BenchArgs*)arg;
+    long visited = 0;
+    Entry* e;
+    while((e = sched_next(args->sched, args->id)) != NULL){
+        visited++;
+        visit(args->shape, e->index_working_size, sched_bench_push, args);
+        sched_flush(args->sched, args->id);
+        destroy_entry(NULL, e);
+        sched_done(args->sched, args->id);
+    }
+    atomic_fetch_add(args->visited, visited);
+    return NULL;
+}
+
+static double clock_seconds(clockid_t clock){
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void run(const BurstShape* shape, int nthreads, int legacy, long* visited_out, double* wall, double* cpu){
+    pthread_t threads[nthreads];
+    BenchArgs args[nthreads];
+    atomic_long visited = 0;
+    atomic_int active_threads = nthreads;
+    sem_t sem;
+    Queue* q = NULL;
+    Scheduler* sched = NULL;
+
+    if(legacy){
+        sem_init(&sem, 0, 0);
+        q = create_q();
+        push_q(q, "root", &sem, 0);
+    } else {
+        sched = create_sched(nthreads);
+        sched_inject(sched, 0, create_entry(NULL, NULL, "root", 0));
+    }
+
+    double wall_start = clock_seconds(CLOCK_MONOTONIC);
+    double cpu_start  = clock_seconds(CLOCK_PROCESS_CPUTIME_ID);
+    for(int i = 0; i < nthreads; i++){
+        args[i] = (BenchArgs){ shape, q, &sem, &active_threads, sched, &visited, i, nthreads };
+        if(pthread_create(&threads[i], NULL, legacy ? legacy_thread : sched_thread, &args[i]) != 0){
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+    *wall = clock_seconds(CLOCK_MONOTONIC) - wall_start;
+    *cpu  = clock_seconds(CLOCK_PROCESS_CPUTIME_ID) - cpu_start;
+
+    if(legacy){
+        destroy_q(q);
+        sem_destroy(&sem);
+    } else {
+        destroy_sched(sched);
+    }
+    *visited_out = visited;
+}
+
+static void best_of(const BurstShape* shape, int nthreads, int legacy, int repeats, long expected, double* wall, double* cpu){
+    *wall = -1;
+    for(int r = 0; r < repeats; r++){
+        long visited;
+        double w, c;
+        run(shape, nthreads, legacy, &visited, &w, &c);
+        if(visited != expected){
+            fprintf(stderr, "%s run with %d threads visited %ld of %ld entries\n",
+                legacy ? "legacy" : "sched", nthreads, visited, expected);
+            exit(EXIT_FAILURE);
+        }
+        if(*wall < 0 || w < *wall){
+            *wall = w;
+            *cpu  = c;
+        }
+    }
+}
+
+int main(int argc, char* argv[]){
+    BurstShape shape = { .spine = 2000, .burst = 64, .leaf_work = 2000, .spine_work = 20000 };
+    int max_threads = 16;
+    int repeats = 3;
+    int opt;
+    while((opt = getopt(argc, argv, "s:b:w:W:t:r:")) != -1){
+        switch(opt){
+            case 's': shape.spine       = atoi(optarg); break;
+            case 'b': shape.burst       = atoi(optarg); break;
+            case 'w': shape.leaf_work   = atol(optarg); break;
+            case 'W': shape.spine_work  = atol(optarg); break;
+            case 't': max_threads       = atoi(optarg); break;
+            case 'r': repeats           = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: burst_bench [-s spine] [-b burst] [-w leaf_work] [-W spine_work] [-t max_threads] [-r repeats]\n");
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(shape.spine < 1 || shape.burst < 0 || max_threads < 1 || repeats < 1){
+        fprintf(stderr, "burst_bench: arguments must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    long expected = (long)shape.spine * (shape.burst + 1);
+    fprintf(stderr, "tree: spine %d, burst %d, %ld entries, work %ld/%ld, %ld cpus\n",
+        shape.spine, shape.burst, expected, shape.spine_work, shape.leaf_work, sysconf(_SC_NPROCESSORS_ONLN));
+
+    printf("threads,legacy_wall,legacy_cpu,sched_wall,sched_cpu\n");
+    for(int n = 1; n <= max_threads; n *= 2){
+        double legacy_wall, legacy_cpu, sched_wall, sched_cpu;
+        best_of(&shape, n, 1, repeats, expected, &legacy_wall, &legacy_cpu);
+        best_of(&shape, n, 0, repeats, expected, &sched_wall, &sched_cpu);
+        printf("%d,%.4f,%.4f,%.4f,%.4f\n", n, legacy_wall, legacy_cpu, sched_wall, sched_cpu);
+        fflush(stdout);
+    }
+    return EXIT_SUCCESS;
+}
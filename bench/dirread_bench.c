@@ -0,0 +1,185 @@
+/**
+ *
+ * Benchmark comparing the `getdents64` based `DirReader` with libc `readdir`.
+ * A synthetic tree is created under a scratch directory: one huge flat
+ * directory with `-n` empty files, and `-s` small directories holding eight
+ * files each. Both readers list the same directories and the best of `-r`
+ * repetitions is reported, once for the huge directory and once for walking
+ * all of the small ones, where `readdir` pays an `opendir`/`closedir` pair each.
+ *
+ * To run:
+ *   make bench-dirread
+ *   ./bench/dirread_bench [-n entries] [-s small_dirs] [-r repeats] [-d scratch_dir] [-k]
+ *
+ * `-k` keeps the generated tree so it can be reused by passing the same `-d`.
+ * Output is CSV on stdout: case,reader,entries,seconds,entries_per_second
+ *
+ * @file dirread_bench.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief DirReader vs. readdir listing benchmark.
+ */
+
+#include "dirread.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define SMALL_DIR_FILES 8
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void create_files(const char* dir, long n){
+    char path[4096];
+    if(mkdir(dir, 0755) == -1 && errno != EEXIST){
+        perror(dir);
+        exit(EXIT_FAILURE);
+    }
+    for(long i = 0; i < n; i++){
+        snprintf(path, sizeof(path), "%s/entry_%08ld", dir, i);
+        int fd = open(path, O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+        if(fd == -1){
+            perror(path);
+            exit(EXIT_FAILURE);
+        }
+        close(fd);
+    }
+}
+
+static long count_readdir(const char* path){
+    DIR* dir = opendir(path);
+    if(dir == NULL){
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    long n = 0;
+    struct dirent* dp;
+    while((dp = readdir(dir)) != NULL){
+        if(strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0) continue;
+        n++;
+    }
+    closedir(dir);
+    return n;
+}
+
+static long count_dirreader(DirReader* r, const char* path){
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if(fd == -1){
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    long n = 0;
+    dirreader_open(r, fd);
+    while(dirreader_next(r) != NULL) n++;
+    close(fd);
+    return n;
+}
+
+static double time_huge(const char* path, int use_reader, DirReader* r, long* entries){
+    double start = now();
+    *entries = use_reader ? count_dirreader(r, path) : count_readdir(path);
+    return now() - start;
+}
+
+static double time_small(const char* root, long ndirs, int use_reader, DirReader* r, long* entries){
+    char path[4096];
+    double start = now();
+    *entries = 0;
+    for(long i = 0; i < ndirs; i++){
+        snprintf(path, sizeof(path), "%s/small/dir_%08ld", root, i);
+        *entries += use_reader ? count_dirreader(r, path) : count_readdir(path);
+    }
+    return now() - start;
+}
+
+static void report(const char* name, const char* reader, long entries, double seconds){
+    printf("%s,%s,%ld,%.6f,%.0f\n", name, reader, entries, seconds, entries / seconds);
+}
+
+int main(int argc, char* argv[]){
+    long nentries = 200000;
+    long ndirs = 20000;
+    int repeats = 5;
+    int keep = 0;
+    char* scratch = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "n:s:r:d:k")) != -1){
+        switch(opt){
+            case 'n': nentries  = atol(optarg); break;
+            case 's': ndirs     = atol(optarg); break;
+            case 'r': repeats   = atoi(optarg); break;
+            case 'd': scratch   = optarg; break;
+            case 'k': keep      = 1; break;
+            default:
+                fprintf(stderr, "Usage: dirread_bench [-n entries] [-s small_dirs] [-r repeats] [-d scratch_dir] [-k]\n");
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(nentries < 0 || ndirs < 0 || repeats < 1){
+        fprintf(stderr, "dirread_bench: arguments must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    char template[] = "/tmp/dirread_bench.XXXXXX";
+    if(scratch == NULL && (scratch = mkdtemp(template)) == NULL){
+        perror("mkdtemp");
+        exit(EXIT_FAILURE);
+    }
+
+    char huge[4096], small[4096], path[8192];
+    snprintf(huge, sizeof(huge), "%s/huge", scratch);
+    snprintf(small, sizeof(small), "%s/small", scratch);
+
+    struct stat st;
+    if(stat(huge, &st) == -1){
+        fprintf(stderr, "creating %ld entries and %ld small directories in %s\n", nentries, ndirs, scratch);
+        mkdir(scratch, 0755);
+        create_files(huge, nentries);
+        mkdir(small, 0755);
+        for(long i = 0; i < ndirs; i++){
+            snprintf(path, sizeof(path), "%s/dir_%08ld", small, i);
+            create_files(path, SMALL_DIR_FILES);
+        }
+    }
+
+    DirReader reader;
+    init_dirreader(&reader, DIRREAD_BUFFER_SIZE);
+
+    printf("case,reader,entries,seconds,entries_per_second\n");
+    for(int use_reader = 0; use_reader <= 1; use_reader++){
+        double best = -1;
+        long entries = 0;
+        for(int i = 0; i < repeats; i++){
+            double t = time_huge(huge, use_reader, &reader, &entries);
+            if(best < 0 || t < best) best = t;
+        }
+        report("huge_dir", use_reader ? "getdents64" : "readdir", entries, best);
+    }
+    for(int use_reader = 0; use_reader <= 1; use_reader++){
+        double best = -1;
+        long entries = 0;
+        for(int i = 0; i < repeats; i++){
+            double t = time_small(scratch, ndirs, use_reader, &reader, &entries);
+            if(best < 0 || t < best) best = t;
+        }
+        report("small_dirs", use_reader ? "getdents64" : "readdir", entries, best);
+    }
+    destroy_dirreader(&reader);
+
+    if(!keep){
+        char cmd[4200];
+        snprintf(cmd, sizeof(cmd), "rm -rf '%s'", scratch);
+        if(system(cmd) != 0) fprintf(stderr, "failed to remove %s\n", scratch);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,209 @@
+/**
+ *
+ * Generator for the deterministic synthetic trees used by the benchmark suite.
+ * The same shape, scale and seed always produce the same names, the same layout
+ * and the same file sizes, so timings taken on different machines or revisions
+ * scan identical trees. File contents are written, not left sparse, so every file
+ * occupies blocks.
+ *
+ * Shapes:
+ *   wide      one level of 1000 directories with 20 files each
+ *   deep      a chain of 2000 nested directories with 2 files each
+ *   small     a tree of fanout 8 and depth 4 with 10 files of at most 512 bytes per directory
+ *   huge      a single directory with 100000 files
+ *   hardlink  200 files, each linked into 50 directories
+ *
+ * The scale multiplies the main dimension of the shape (directories, depth, files
+ * or links), for `small` it adds levels to the tree instead. The number of entries
+ * created, including `dir` itself, is printed on stdout.
+ *
+ * To run:
+ *   make bench/gentree
+ *   ./bench/gentree [-x scale] [-S seed] shape dir
+ *
+ * @file gentree.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Deterministic synthetic tree generator.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#define MAX_FILE_SIZE 16384
+
+typedef struct {
+    unsigned long long state;
+    long entries;
+} Generator;
+
+static char contents[MAX_FILE_SIZE];
+
+static unsigned long long next_random(Generator* g){
+    g->state ^= g->state << 13;
+    g->state ^= g->state >> 7;
+    g->state ^= g->state << 17;
+    return g->state;
+}
+
+static void make_dir(Generator* g, const char* path){
+    if(mkdir(path, 0755) == -1){
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    g->entries++;
+}
+
+static void make_file(Generator* g, const char* path, size_t max_size){
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if(fd == -1){
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    size_t size = next_random(g) % (max_size + 1);
+    if(write(fd, contents, size) != (ssize_t)size){
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+    g->entries++;
+}
+
+static void make_link(Generator* g, const char* target, const char* path){
+    if(link(target, path) == -1){
+        perror(path);
+        exit(EXIT_FAILURE);
+    }
+    g->entries++;
+}
+
+static void join(char* out, const char* dir, const char* fmt, long n){
+    char name[64];
+    snprintf(name, sizeof(name), fmt, n);
+    if(snprintf(out, PATH_MAX, "%s/%s", dir, name) >= PATH_MAX){
+        fprintf(stderr, "gentree: path too long below %s\n", dir);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void gen_files(Generator* g, const char* dir, int nfiles, size_t max_size){
+    char path[PATH_MAX];
+    for(int i = 0; i < nfiles; i++){
+        join(path, dir, "f%05ld", i);
+        make_file(g, path, max_size);
+    }
+}
+
+static void gen_wide(Generator* g, const char* root, int scale){
+    char path[PATH_MAX];
+    for(long d = 0; d < 1000L * scale; d++){
+        join(path, root, "d%06ld", d);
+        make_dir(g, path);
+        gen_files(g, path, 20, MAX_FILE_SIZE);
+    }
+}
+
+static void gen_deep(Generator* g, const char* root, int scale){
+    //Relative paths keep every call short however deep the chain goes.
+    int dirfd = open(".", O_RDONLY | O_DIRECTORY);
+    if(dirfd == -1 || chdir(root) == -1){
+        perror(root);
+        exit(EXIT_FAILURE);
+    }
+    for(long d = 0; d < 2000L * scale; d++){
+        gen_files(g, ".", 2, MAX_FILE_SIZE);
+        make_dir(g, "d");
+        if(chdir("d") == -1){
+            perror("chdir");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if(fchdir(dirfd) == -1){
+        perror("fchdir");
+        exit(EXIT_FAILURE);
+    }
+    close(dirfd);
+}
+
+static void gen_small(Generator* g, const char* dir, int depth){
+    char path[PATH_MAX];
+    gen_files(g, dir, 10, 512);
+    if(depth == 0) return;
+    for(int i = 0; i < 8; i++){
+        join(path, dir, "d%ld", i);
+        make_dir(g, path);
+        gen_small(g, path, depth - 1);
+    }
+}
+
+static void gen_huge(Generator* g, const char* root, int scale){
+    char path[PATH_MAX];
+    for(long i = 0; i < 100000L * scale; i++){
+        join(path, root, "f%07ld", i);
+        make_file(g, path, 4096);
+    }
+}
+
+static void gen_hardlink(Generator* g, const char* root, int scale){
+    char path[PATH_MAX];
+    char target[PATH_MAX];
+    int ndirs = 50 * scale;
+    for(long d = 0; d < ndirs; d++){
+        join(path, root, "d%04ld", d);
+        make_dir(g, path);
+    }
+    for(long f = 0; f < 200; f++){
+        join(path, root, "d%04ld", 0);
+        join(target, path, "f%05ld", f);
+        make_file(g, target, MAX_FILE_SIZE);
+        for(long d = 1; d < ndirs; d++){
+            join(path, root, "d%04ld", d);
+            char link_path[PATH_MAX];
+            join(link_path, path, "f%05ld", f);
+            make_link(g, target, link_path);
+        }
+    }
+}
+
+int main(int argc, char* argv[]){
+    int scale = 1;
+    unsigned long long seed = 1;
+    int opt;
+    while((opt = getopt(argc, argv, "x:S:")) != -1){
+        switch(opt){
+            case 'x': scale = atoi(optarg);               break;
+            case 'S': seed  = strtoull(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "Usage: gentree [-x scale] [-S seed] wide|deep|small|huge|hardlink dir\n");
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(argc - optind != 2 || scale < 1){
+        fprintf(stderr, "Usage: gentree [-x scale] [-S seed] wide|deep|small|huge|hardlink dir\n");
+        exit(EXIT_FAILURE);
+    }
+    const char* shape = argv[optind];
+    const char* root  = argv[optind + 1];
+
+    Generator g = { .state = seed == 0 ? 1 : seed, .entries = 0 };
+    for(size_t i = 0; i < sizeof(contents); i++) contents[i] = (char)('a' + i % 26);
+
+    make_dir(&g, root);
+    if     (strcmp(shape, "wide")     == 0) gen_wide(&g, root, scale);
+    else if(strcmp(shape, "deep")     == 0) gen_deep(&g, root, scale);
+    else if(strcmp(shape, "small")    == 0) gen_small(&g, root, 3 + scale);
+    else if(strcmp(shape, "huge")     == 0) gen_huge(&g, root, scale);
+    else if(strcmp(shape, "hardlink") == 0) gen_hardlink(&g, root, scale);
+    else {
+        fprintf(stderr, "gentree: unknown shape '%s'\n", shape);
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%ld\n", g.entries);
+    return EXIT_SUCCESS;
+}
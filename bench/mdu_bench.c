@@ -0,0 +1,128 @@
+/**
+ *
+ * Trial runner for the benchmark suite. Runs a command, normally `mdu` scanning a
+ * generated tree, a number of times and reports the median and 95th percentile
+ * wall time, the entry rate at the median and the peak resident set size over all
+ * trials. The command's stdout is discarded.
+ *
+ * Warm trials are preceded by one untimed run that fills the page, inode and
+ * dentry caches. Cold trials (`-c`) sync and write 3 to /proc/sys/vm/drop_caches
+ * before every trial, which requires root. If the caches cannot be dropped the
+ * runner exits with status 2 without running anything.
+ *
+ * To run:
+ *   make bench/mdu_bench
+ *   ./bench/mdu_bench [-t trials] [-c] [-n entries] command [args ...]
+ *
+ * Output is one CSV line on stdout: median_s,p95_s,entries_per_s,peak_rss_kb
+ *
+ * @file mdu_bench.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Repeated timing of one benchmark command.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+static int drop_caches(void){
+    sync();
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+    if(fd == -1) return -1;
+    int ok = write(fd, "3", 1) == 1;
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//Runs the command once and returns its wall time, adding its peak RSS to `rss_kb`.
+static double run_once(char* argv[], long* rss_kb){
+    double start = now();
+    pid_t pid = fork();
+    if(pid == -1){
+        perror("fork");
+        exit(EXIT_FAILURE);
+    }
+    if(pid == 0){
+        int null = open("/dev/null", O_WRONLY);
+        if(null != -1) dup2(null, STDOUT_FILENO);
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if(wait4(pid, &status, 0, &usage) == -1){
+        perror("wait4");
+        exit(EXIT_FAILURE);
+    }
+    double elapsed = now() - start;
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+        fprintf(stderr, "mdu_bench: %s failed\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    if(usage.ru_maxrss > *rss_kb) *rss_kb = usage.ru_maxrss;
+    return elapsed;
+}
+
+static int compare_doubles(const void* a, const void* b){
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char* argv[]){
+    int trials = 5;
+    int cold = 0;
+    long entries = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "+t:cn:")) != -1){
+        switch(opt){
+            case 't': trials  = atoi(optarg); break;
+            case 'c': cold    = 1;            break;
+            case 'n': entries = atol(optarg); break;
+            default:
+                fprintf(stderr, "Usage: mdu_bench [-t trials] [-c] [-n entries] command [args ...]\n");
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(optind >= argc || trials < 1){
+        fprintf(stderr, "Usage: mdu_bench [-t trials] [-c] [-n entries] command [args ...]\n");
+        exit(EXIT_FAILURE);
+    }
+    char** command = argv + optind;
+
+    if(cold && drop_caches() == -1){
+        perror("mdu_bench: drop_caches");
+        exit(2);
+    }
+
+    long rss_kb = 0;
+    double times[trials];
+    if(!cold) run_once(command, &rss_kb);
+    for(int i = 0; i < trials; i++){
+        if(cold && drop_caches() == -1){
+            perror("mdu_bench: drop_caches");
+            exit(2);
+        }
+        times[i] = run_once(command, &rss_kb);
+    }
+
+    //Nearest-rank percentiles.
+    qsort(times, trials, sizeof(double), compare_doubles);
+    double median = times[(trials + 1) / 2 - 1];
+    double p95    = times[(95 * trials + 99) / 100 - 1];
+    printf("%.4f,%.4f,%.0f,%ld\n", median, p95, median > 0 ? entries / median : 0, rss_kb);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+/**
+ *
+ * Scaling benchmark comparing the work-stealing scheduler with the original
+ * mutex-protected `Queue`. Both variants traverse the same synthetic tree held
+ * entirely in memory: every entry spawns `fanout` children until `depth` is
+ * reached, and each entry spins for `work` iterations to stand in for a syscall.
+ * No file system is touched, so the measured time is scheduling overhead.
+ *
+ * The legacy variant reproduces the original worker loop: a shared semaphore,
+ * `push_q`/`pop_q` under the queue mutex and termination through an active
+ * thread counter combined with `is_queue_empty`.
+ *
+ * To run:
+ *   make bench-sched
+ *   ./bench/sched_bench [-f fanout] [-d depth] [-w work] [-t max_threads] [-r repeats]
+ *
+ * Output is CSV on stdout: threads,legacy_seconds,deque_seconds,speedup
+ *
+ * @file sched_bench.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Queue vs. work-stealing scheduler scaling benchmark.
+ */
+
+#include "queue.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+
+typedef struct {
+    int fanout;
+    int depth;
+    long work;
+} TreeShape;
+
+typedef struct {
+    const TreeShape* shape;
+    Queue* q;
+    sem_t* sem;
+    atomic_short* active_threads;
+    Scheduler* sched;
+    atomic_long* visited;
+    int id;
+    int nthreads;
+} BenchArgs;
+
+static volatile long sink;
+
+static void spin(long work){
+    long acc = 0;
+    for(long i = 0; i < work; i++) acc += i;
+    sink = acc;
+}
+
+static void* legacy_thread(void* arg){
+    BenchArgs* args = (BenchArgs*)arg;
+    int finished = 0;
+    long visited = 0;
+    char* path = NULL;
+    while(1){
+        atomic_fetch_add(args->active_threads, -1);
+        if (is_queue_empty(args->q) && *args->active_threads == 0) {
+            finished = 1;
+            for(int i = 0; i < args->nthreads; i++) sem_post(args->sem);
+        }
+
+        sem_wait(args->sem);
+        if(finished) break;
+        atomic_fetch_add(args->active_threads, +1);
+
+        int depth = 0;
+        free(path);
+        if((path = pop_q(args->q, &depth)) == NULL) continue;
+
+        visited++;
+        spin(args->shape->work);
+        if(depth < args->shape->depth){
+            for(int i = 0; i < args->shape->fanout; i++) push_q(args->q, "entry", args->sem, depth + 1);
+        }
+    }
+    free(path);
+    atomic_fetch_add(args->visited, visited);
+    return NULL;
+}
+
+static void* deque_thread(void* arg){
+    BenchArgs* args = (BenchArgs*)arg;
+    long visited = 0;
+    Entry* e;
+    while((e = sched_next(args->sched, args->id)) != NULL){
+        int depth = e->index_working_size;
+        visited++;
+        spin(args->shape->work);
+        if(depth < args->shape->depth){
+            for(int i = 0; i < args->shape->fanout; i++) sched_push(args->sched, args->id, create_entry(NULL, NULL, "entry", depth + 1));
+            sched_flush(args->sched, args->id);
+        }
+        destroy_entry(NULL, e);
+        sched_done(args->sched, args->id);
+    }
+    atomic_fetch_add(args->visited, visited);
+    return NULL;
+}
+
+static double now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(const TreeShape* shape, int nthreads, int legacy, long* visited_out){
+    pthread_t threads[nthreads];
+    BenchArgs args[nthreads];
+    atomic_long visited = 0;
+    atomic_short active_threads = nthreads;
+    sem_t sem;
+    Queue* q = NULL;
+    Scheduler* sched = NULL;
+
+    if(legacy){
+        sem_init(&sem, 0, 0);
+        q = create_q();
+        push_q(q, "root", &sem, 0);
+    } else {
+        sched = create_sched(nthreads);
+        sched_inject(sched, 0, create_entry(NULL, NULL, "root", 0));
+    }
+
+    double start = now();
+    for(int i = 0; i < nthreads; i++){
+        args[i] = (BenchArgs){ shape, q, &sem, &active_threads, sched, &visited, i, nthreads };
+        if(pthread_create(&threads[i], NULL, legacy ? legacy_thread : deque_thread, &args[i]) != 0){
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+    double elapsed = now() - start;
+
+    if(legacy){
+        destroy_q(q);
+        sem_destroy(&sem);
+    } else {
+        destroy_sched(sched);
+    }
+    *visited_out = visited;
+    return elapsed;
+}
+
+static double best_of(const TreeShape* shape, int nthreads, int legacy, int repeats, long expected){
+    double best = -1;
+    for(int r = 0; r < repeats; r++){
+        long visited;
+        double t = run(shape, nthreads, legacy, &visited);
+        if(visited != expected){
+            fprintf(stderr, "%s run with %d threads visited %ld of %ld entries\n",
+                legacy ? "legacy" : "deque", nthreads, visited, expected);
+            exit(EXIT_FAILURE);
+        }
+        if(best < 0 || t < best) best = t;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]){
+    TreeShape shape = { .fanout = 8, .depth = 6, .work = 200 };
+    int max_threads = 64;
+    int repeats = 3;
+    int opt;
+    while((opt = getopt(argc, argv, "f:d:w:t:r:")) != -1){
+        switch(opt){
+            case 'f': shape.fanout  = atoi(optarg); break;
+            case 'd': shape.depth   = atoi(optarg); break;
+            case 'w': shape.work    = atol(optarg); break;
+            case 't': max_threads   = atoi(optarg); break;
+            case 'r': repeats       = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: sched_bench [-f fanout] [-d depth] [-w work] [-t max_threads] [-r repeats]\n");
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(shape.fanout < 1 || shape.depth < 0 || max_threads < 1 || repeats < 1){
+        fprintf(stderr, "sched_bench: arguments must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    long expected = 0, level = 1;
+    for(int d = 0; d <= shape.depth; d++){
+        expected += level;
+        level *= shape.fanout;
+    }
+    fprintf(stderr, "tree: fanout %d, depth %d, %ld entries, work %ld, %ld cpus\n",
+        shape.fanout, shape.depth, expected, shape.work, sysconf(_SC_NPROCESSORS_ONLN));
+
+    printf("threads,legacy_seconds,deque_seconds,speedup\n");
+    for(int n = 1; n <= max_threads; n *= 2){
+        double legacy = best_of(&shape, n, 1, repeats, expected);
+        double deque  = best_of(&shape, n, 0, repeats, expected);
+        printf("%d,%.4f,%.4f,%.2f\n", n, legacy, deque, legacy / deque);
+        fflush(stdout);
+    }
+    return EXIT_SUCCESS;
+}
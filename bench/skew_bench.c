@@ -0,0 +1,190 @@
+/**
+ *
+ * Benchmark of size-predictive scheduling on skewed trees. The root holds `-n`
+ * small directories of `-s` files each and one deep directory, a spine of `-d`
+ * levels where every level holds the next one and `-b` files. Every entry sleeps
+ * for `-w` microseconds, standing in for the latency of listing or sizing it on a
+ * slow or remote filesystem, so the workers overlap their waits as the workers of
+ * mdu do and the benchmark is meaningful on any number of CPUs.
+ *
+ * Without hints the next level of the spine waits in a deque behind the files of
+ * its level until its worker gets to it or another worker runs out of work and
+ * steals it, so while the small directories keep the workers busy the spine
+ * barely advances and its tail is walked by one worker at the end. With hints
+ * every level of the spine carries the number of entries below it, as read from
+ * a `--hints` file, and is scheduled ahead of all other work, so the spine is
+ * walked while the other workers size the small directories.
+ *
+ * To run:
+ *   make bench-skew
+ *   ./bench/skew_bench [-n small_dirs] [-s files] [-d depth] [-b files_per_level] [-w latency_us] [-t max_threads] [-r repeats]
+ *
+ * Output is CSV on stdout:
+ *   threads,plain_wall,hints_wall
+ *
+ * @file skew_bench.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Size-predictive scheduling benchmark on skewed trees.
+ */
+
+#include "queue.h"
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define FILE_ENTRY  -1
+#define SMALL_DIR   -2
+#define ROOT        -3
+
+typedef struct {
+    int small_dirs;
+    int files;
+    int depth;
+    int level_files;
+    long latency_us;
+} SkewShape;
+
+typedef struct {
+    const SkewShape* shape;
+    Scheduler* sched;
+    atomic_long* visited;
+    int hints;
+    int id;
+} BenchArgs;
+
+static void wait_latency(long us){
+    struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000 };
+    while(nanosleep(&ts, &ts) == -1);
+}
+
+static void push(BenchArgs* args, int kind, long hint){
+    Entry* e = create_entry(NULL, NULL, "entry", kind);
+    e->hint = args->hints ? hint : 0;
+    sched_push(args->sched, args->id, e);
+}
+
+//Entries below spine level `level`, the level itself excluded.
+static long spine_entries(const SkewShape* shape, int level){
+    return (long)(shape->depth - level - 1) * (shape->level_files + 1) + shape->level_files;
+}
+
+//Waits for the entry and schedules its children.
+static void visit(BenchArgs* args, int kind){
+    const SkewShape* shape = args->shape;
+    wait_latency(shape->latency_us);
+    if(kind == FILE_ENTRY) return;
+    if(kind == SMALL_DIR){
+        for(int i = 0; i < shape->files; i++) push(args, FILE_ENTRY, 0);
+        return;
+    }
+    if(kind == ROOT){
+        push(args, 0, spine_entries(shape, 0));
+        for(int i = 0; i < shape->small_dirs; i++) push(args, SMALL_DIR, 0);
+        return;
+    }
+    if(kind + 1 < shape->depth) push(args, kind + 1, spine_entries(shape, kind + 1));
+    for(int i = 0; i < shape->level_files; i++) push(args, FILE_ENTRY, 0);
+}
+
+static void* bench_thread(void* arg){
+    BenchArgs* args = (BenchArgs*)arg;
+    long visited = 0;
+    Entry* e;
+    while((e = sched_next(args->sched, args->id)) != NULL){
+        visited++;
+        visit(args, e->index_working_size);
+        sched_flush(args->sched, args->id);
+        destroy_entry(NULL, e);
+        sched_done(args->sched, args->id);
+    }
+    atomic_fetch_add(args->visited, visited);
+    return NULL;
+}
+
+static double clock_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double run(const SkewShape* shape, int nthreads, int hints, long* visited_out){
+    pthread_t threads[nthreads];
+    BenchArgs args[nthreads];
+    atomic_long visited = 0;
+    Scheduler* sched = create_sched(nthreads);
+    sched_inject(sched, 0, create_entry(NULL, NULL, "root", ROOT));
+
+    double start = clock_seconds();
+    for(int i = 0; i < nthreads; i++){
+        args[i] = (BenchArgs){ shape, sched, &visited, hints, i };
+        if(pthread_create(&threads[i], NULL, bench_thread, &args[i]) != 0){
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int i = 0; i < nthreads; i++) pthread_join(threads[i], NULL);
+    double wall = clock_seconds() - start;
+
+    destroy_sched(sched);
+    *visited_out = visited;
+    return wall;
+}
+
+static double best_of(const SkewShape* shape, int nthreads, int hints, int repeats, long expected){
+    double best = -1;
+    for(int r = 0; r < repeats; r++){
+        long visited;
+        double wall = run(shape, nthreads, hints, &visited);
+        if(visited != expected){
+            fprintf(stderr, "%s run with %d threads visited %ld of %ld entries\n",
+                hints ? "hints" : "plain", nthreads, visited, expected);
+            exit(EXIT_FAILURE);
+        }
+        if(best < 0 || wall < best) best = wall;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]){
+    SkewShape shape = { .small_dirs = 200, .files = 50, .depth = 1000, .level_files = 10, .latency_us = 100 };
+    int max_threads = 32;
+    int repeats = 3;
+    int opt;
+    while((opt = getopt(argc, argv, "n:s:d:b:w:t:r:")) != -1){
+        switch(opt){
+            case 'n': shape.small_dirs  = atoi(optarg); break;
+            case 's': shape.files       = atoi(optarg); break;
+            case 'd': shape.depth       = atoi(optarg); break;
+            case 'b': shape.level_files = atoi(optarg); break;
+            case 'w': shape.latency_us  = atol(optarg); break;
+            case 't': max_threads       = atoi(optarg); break;
+            case 'r': repeats           = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: skew_bench [-n small_dirs] [-s files] [-d depth] [-b files_per_level] [-w latency_us] [-t max_threads] [-r repeats]\n");
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(shape.small_dirs < 0 || shape.files < 0 || shape.depth < 1 || shape.level_files < 0
+            || shape.latency_us < 0 || max_threads < 1 || repeats < 1){
+        fprintf(stderr, "skew_bench: arguments must be positive\n");
+        exit(EXIT_FAILURE);
+    }
+
+    long expected = 1 + (long)shape.small_dirs * (shape.files + 1) + 1 + spine_entries(&shape, 0);
+    fprintf(stderr, "tree: %d small directories of %d files, spine of %d levels with %d files, %ld entries, %ld us each, %ld cpus\n",
+        shape.small_dirs, shape.files, shape.depth, shape.level_files, expected, shape.latency_us, sysconf(_SC_NPROCESSORS_ONLN));
+
+    printf("threads,plain_wall,hints_wall\n");
+    for(int n = 1; n <= max_threads; n *= 2){
+        double plain = best_of(&shape, n, 0, repeats, expected);
+        double hints = best_of(&shape, n, 1, repeats, expected);
+        printf("%d,%.4f,%.4f\n", n, plain, hints);
+        fflush(stdout);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#!/bin/bash
+# Benchmark suite timing mdu on deterministic synthetic trees.
+#
+# Usage: bench/suite.sh [-d dir] [-s shapes] [-j threads] [-e engines] [-t trials] [-x scale] [-b binary] [-a args]
+#   -d  directory holding the generated trees (default /tmp/mdu-bench), trees
+#       are generated by bench/gentree on first use and reused afterwards
+#   -s  shapes to scan (default "wide deep small huge hardlink")
+#   -j  thread counts (default "1 2 4 8"), `auto` or `auto:N` measure the adaptive controller
+#   -e  engines (default "thread uring")
+#   -t  trials per configuration (default 5)
+#   -x  gentree scale (default 1)
+#   -b  mdu binary (default ./mdu)
+#   -a  further mdu options for every run, e.g. "--split-dirs=1000"
+#
+# Every configuration is run with warm caches and, when running as root, with
+# dropped caches before every trial.
+#
+# Output is CSV: shape,entries,engine,threads,caches,median_s,p95_s,entries_per_s,peak_rss_kb
+
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+dir=/tmp/mdu-bench
+shapes="wide deep small huge hardlink"
+threads="1 2 4 8"
+engines="thread uring"
+trials=5
+scale=1
+bin=$root/mdu
+args=
+while getopts "d:s:j:e:t:x:b:a:" opt; do
+    case $opt in
+        d) dir=$OPTARG ;;
+        s) shapes=$OPTARG ;;
+        j) threads=$OPTARG ;;
+        e) engines=$OPTARG ;;
+        t) trials=$OPTARG ;;
+        x) scale=$OPTARG ;;
+        b) bin=$OPTARG ;;
+        a) args=$OPTARG ;;
+        *) echo "Usage: $0 [-d dir] [-s shapes] [-j threads] [-e engines] [-t trials] [-x scale] [-b binary] [-a args]" >&2; exit 1 ;;
+    esac
+done
+
+make -s -C "$root" mdu bench/gentree bench/mdu_bench
+mkdir -p "$dir"
+
+caches="warm cold"
+if ! "$root/bench/mdu_bench" -c -t 1 true >/dev/null 2>&1; then
+    echo "$0: cannot drop caches, running warm trials only" >&2
+    caches=warm
+fi
+
+echo "shape,entries,engine,threads,caches,median_s,p95_s,entries_per_s,peak_rss_kb"
+for shape in $shapes; do
+    tree=$dir/$shape-x$scale
+    if [ ! -f "$tree.entries" ]; then
+        echo "$0: generating $tree" >&2
+        "$root/bench/gentree" -x "$scale" "$shape" "$tree" > "$tree.entries.tmp"
+        mv "$tree.entries.tmp" "$tree.entries"
+    fi
+    entries=$(cat "$tree.entries")
+
+    for engine in $engines; do
+        for j in $threads; do
+            for mode in $caches; do
+                flag=
+                [ "$mode" = cold ] && flag=-c
+                result=$("$root/bench/mdu_bench" $flag -t "$trials" -n "$entries" \
+                    "$bin" -j "$j" --engine="$engine" $args "$tree")
+                echo "$shape,$entries,$engine,$j,$mode,$result"
+            done
+        done
+    done
+done
@@ -0,0 +1,316 @@
+#include "cache.h"
+
+void cache_key_from_stat(CacheKey* key, const struct stat* st){
+    key->dev        = st->st_dev;
+    key->ino        = st->st_ino;
+    key->mtime_sec  = st->st_mtim.tv_sec;
+    key->mtime_nsec = st->st_mtim.tv_nsec;
+    key->ctime_sec  = st->st_ctim.tv_sec;
+    key->ctime_nsec = st->st_ctim.tv_nsec;
+}
+
+static bool valid_cache(const void* map, size_t size){
+    const CacheHeader* h = map;
+    if(size < sizeof(CacheHeader)) return false;
+    if(memcmp(h->magic, CACHE_MAGIC, sizeof(h->magic)) != 0) return false;
+    if(h->version != CACHE_VERSION || h->record_size != sizeof(CacheRecord)) return false;
+    if(h->nrecords > (size - sizeof(CacheHeader)) / sizeof(CacheRecord)) return false;
+    if(h->links_offset != sizeof(CacheHeader) + h->nrecords * sizeof(CacheRecord)) return false;
+    if(h->nlinks > (size - h->links_offset) / sizeof(CacheLink)) return false;
+    if(h->names_offset != h->links_offset + h->nlinks * sizeof(CacheLink)) return false;
+    if(h->names_size > size - h->names_offset) return false;
+
+    const CacheRecord* records = (const CacheRecord*)(h + 1);
+    for(uint64_t i = 0; i < h->nrecords; i++){
+        if(records[i].first_link > h->nlinks) return false;
+        if(records[i].nlinks > h->nlinks - records[i].first_link) return false;
+        if(records[i].names_offset > h->names_size) return false;
+        if(records[i].names_size > h->names_size - records[i].names_offset) return false;
+    }
+    return true;
+}
+
+ScanCache* open_cache(const char* path){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1){
+        if(errno != ENOENT) perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) == -1 || st.st_size == 0){
+        close(fd);
+        return NULL;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(map == MAP_FAILED){
+        perror("mmap");
+        close(fd);
+        return NULL;
+    }
+    if(!valid_cache(map, st.st_size)){
+        fprintf(stderr, "mdu: ignoring invalid cache %s\n", path);
+        munmap(map, st.st_size);
+        close(fd);
+        return NULL;
+    }
+    madvise(map, st.st_size, MADV_RANDOM);
+
+    ScanCache* cache = malloc(sizeof(ScanCache));
+    if(cache == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    cache->fd       = fd;
+    cache->map      = map;
+    cache->size     = st.st_size;
+    cache->header   = map;
+    cache->records  = (const CacheRecord*)(cache->header + 1);
+    cache->links    = (const CacheLink*)((const char*)map + cache->header->links_offset);
+    cache->names    = (const char*)map + cache->header->names_offset;
+    return cache;
+}
+
+void close_cache(ScanCache* cache){
+    if(cache == NULL) return;
+    if(cache->fd == -1){
+        free(cache->map);
+    } else {
+        munmap(cache->map, cache->size);
+        close(cache->fd);
+    }
+    free(cache);
+}
+
+static int compare_id(uint64_t dev_a, uint64_t ino_a, uint64_t dev_b, uint64_t ino_b){
+    if(dev_a != dev_b) return dev_a < dev_b ? -1 : 1;
+    if(ino_a != ino_b) return ino_a < ino_b ? -1 : 1;
+    return 0;
+}
+
+const CacheRecord* cache_lookup(const ScanCache* cache, const CacheKey* key){
+    if(cache == NULL) return NULL;
+    size_t lo = 0;
+    size_t hi = cache->header->nrecords;
+    while(lo < hi){
+        size_t mid = lo + (hi - lo) / 2;
+        const CacheKey* k = &cache->records[mid].key;
+        int c = compare_id(k->dev, k->ino, key->dev, key->ino);
+        if(c == 0){
+            return memcmp(k, key, sizeof(CacheKey)) == 0 ? &cache->records[mid] : NULL;
+        }
+        if(c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return NULL;
+}
+
+const char* cache_names(const ScanCache* cache, const CacheRecord* rec){
+    return cache->names + rec->names_offset;
+}
+
+const CacheLink* cache_links(const ScanCache* cache, const CacheRecord* rec){
+    return cache->links + rec->first_link;
+}
+
+void init_collector(CacheCollector* c){
+    memset(c, 0, sizeof(CacheCollector));
+}
+
+void destroy_collector(CacheCollector* c){
+    for(size_t i = 0; i < c->count; i++){
+        PendingRecord* p = &c->chunks[i / CACHE_CHUNK_RECORDS][i % CACHE_CHUNK_RECORDS];
+        free(p->links);
+        free(p->names);
+    }
+    for(size_t i = 0; i < c->nchunks; i++) free(c->chunks[i]);
+    free(c->chunks);
+    free(c->scratch);
+    init_collector(c);
+}
+
+PendingRecord* collector_begin(CacheCollector* c, const CacheKey* key){
+    if(c->count == c->nchunks * CACHE_CHUNK_RECORDS){
+        PendingRecord** chunks = realloc(c->chunks, (c->nchunks + 1) * sizeof(PendingRecord*));
+        if(chunks == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        c->chunks = chunks;
+        c->chunks[c->nchunks] = malloc(CACHE_CHUNK_RECORDS * sizeof(PendingRecord));
+        if(c->chunks[c->nchunks] == NULL){
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        c->nchunks++;
+    }
+
+    PendingRecord* p = &c->chunks[c->count / CACHE_CHUNK_RECORDS][c->count % CACHE_CHUNK_RECORDS];
+    c->count++;
+    memset(&p->rec, 0, sizeof(CacheRecord));
+    p->rec.key          = *key;
+    p->links            = NULL;
+    p->names            = NULL;
+    c->scratch_len      = 0;
+    c->scratch_names    = 0;
+    return p;
+}
+
+void collector_add_name(CacheCollector* c, const char* name){
+    size_t len = strlen(name) + 1;
+    if(c->scratch_len + len > c->scratch_cap){
+        size_t cap = c->scratch_cap == 0 ? 4096 : c->scratch_cap;
+        while(cap < c->scratch_len + len) cap *= 2;
+        char* scratch = realloc(c->scratch, cap);
+        if(scratch == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        c->scratch      = scratch;
+        c->scratch_cap  = cap;
+    }
+    memcpy(c->scratch + c->scratch_len, name, len);
+    c->scratch_len += len;
+    c->scratch_names++;
+}
+
+void collector_add_link(PendingRecord* p, dev_t dev, ino_t ino, long blocks){
+    uint32_t n = p->rec.nlinks;
+    //A power of two count is full, the first link allocates as well.
+    if((n & (n - 1)) == 0){
+        CacheLink* links = realloc(p->links, (n == 0 ? 1 : 2 * n) * sizeof(CacheLink));
+        if(links == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        p->links = links;
+    }
+    p->links[n] = (CacheLink){ .dev = dev, .ino = ino, .blocks = blocks };
+    p->rec.nlinks++;
+}
+
+void collector_end(CacheCollector* c, PendingRecord* p){
+    p->rec.nnames       = c->scratch_names;
+    p->rec.names_size   = c->scratch_len;
+    if(c->scratch_len == 0) return;
+
+    p->names = malloc(c->scratch_len);
+    if(p->names == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(p->names, c->scratch, c->scratch_len);
+}
+
+static int compare_pending(const void* a, const void* b){
+    const CacheKey* ka = &(*(PendingRecord* const*)a)->rec.key;
+    const CacheKey* kb = &(*(PendingRecord* const*)b)->rec.key;
+    return compare_id(ka->dev, ka->ino, kb->dev, kb->ino);
+}
+
+static void* layout_cache(CacheCollector collectors[], int n, size_t* size){
+    size_t total = 0;
+    for(int i = 0; i < n; i++) total += collectors[i].count;
+
+    PendingRecord** sorted = malloc((total + 1) * sizeof(PendingRecord*));
+    if(sorted == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t count = 0;
+    for(int i = 0; i < n; i++){
+        for(size_t j = 0; j < collectors[i].count; j++){
+            sorted[count++] = &collectors[i].chunks[j / CACHE_CHUNK_RECORDS][j % CACHE_CHUNK_RECORDS];
+        }
+    }
+    qsort(sorted, count, sizeof(PendingRecord*), compare_pending);
+
+    //A directory reached through two command line paths is recorded twice, keep one.
+    size_t unique = 0;
+    for(size_t i = 0; i < count; i++){
+        if(unique > 0 && compare_pending(&sorted[unique - 1], &sorted[i]) == 0) continue;
+        sorted[unique++] = sorted[i];
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version      = CACHE_VERSION;
+    header.record_size  = sizeof(CacheRecord);
+    header.nrecords     = unique;
+    header.links_offset = sizeof(CacheHeader) + unique * sizeof(CacheRecord);
+    for(size_t i = 0; i < unique; i++){
+        sorted[i]->rec.first_link   = header.nlinks;
+        sorted[i]->rec.names_offset = header.names_size;
+        header.nlinks       += sorted[i]->rec.nlinks;
+        header.names_size   += sorted[i]->rec.names_size;
+    }
+    header.names_offset = header.links_offset + header.nlinks * sizeof(CacheLink);
+
+    *size = header.names_offset + header.names_size;
+    char* buffer = malloc(*size);
+    if(buffer == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(buffer, &header, sizeof(header));
+    CacheRecord* records = (CacheRecord*)(buffer + sizeof(header));
+    CacheLink* links = (CacheLink*)(buffer + header.links_offset);
+    for(size_t i = 0; i < unique; i++){
+        records[i] = sorted[i]->rec;
+        if(sorted[i]->rec.nlinks > 0){
+            memcpy(links + records[i].first_link, sorted[i]->links, records[i].nlinks * sizeof(CacheLink));
+        }
+        if(sorted[i]->rec.names_size > 0){
+            memcpy(buffer + header.names_offset + records[i].names_offset, sorted[i]->names, records[i].names_size);
+        }
+    }
+    free(sorted);
+    return buffer;
+}
+
+ScanCache* collect_cache(CacheCollector collectors[], int n){
+    ScanCache* cache = malloc(sizeof(ScanCache));
+    if(cache == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    cache->fd       = -1;
+    cache->map      = layout_cache(collectors, n, &cache->size);
+    cache->header   = cache->map;
+    cache->records  = (const CacheRecord*)(cache->header + 1);
+    cache->links    = (const CacheLink*)((const char*)cache->map + cache->header->links_offset);
+    cache->names    = (const char*)cache->map + cache->header->names_offset;
+    return cache;
+}
+
+int write_cache(const char* path, CacheCollector collectors[], int n){
+    size_t size;
+    void* buffer = layout_cache(collectors, n, &size);
+
+    size_t len = strlen(path);
+    char* tmp = malloc(len + sizeof(".tmp"));
+    if(tmp == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+    int ret = -1;
+    FILE* f = fopen(tmp, "wb");
+    if(f != NULL){
+        ret = fwrite(buffer, size, 1, f) == 1 ? 0 : -1;
+        if(fclose(f) != 0) ret = -1;
+        if(ret == 0) ret = rename(tmp, path);
+        if(ret != 0){
+            int err = errno;
+            unlink(tmp);
+            errno = err;
+        }
+    }
+    free(tmp);
+    free(buffer);
+    return ret;
+}
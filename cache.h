@@ -0,0 +1,271 @@
+/**
+ *
+ * This file defines the persistent scan cache enabled with `--cache=FILE`. For
+ * every directory listed during a scan the cache stores the directory's identity
+ * and modification times, the blocks used by its own non-directory entries, its
+ * subtree total and the names of the entries that were scheduled from it
+ * (subdirectories and entries of unknown type).
+ *
+ * On the next scan a directory whose (device, inode, mtime, ctime) is unchanged is
+ * not listed: its own entries are taken from the cache and only the recorded
+ * subdirectories are scheduled, each of which is checked against the cache in
+ * turn. Rescan cost then grows with the number of directories and the changed
+ * ones, not with the number of files.
+ *
+ * Files with several hard links are not part of `own_blocks`. Each record lists
+ * them as links with their identity and blocks instead, and replaying a record
+ * enters them in the inode set like stating them would, so a file linked into a
+ * cached directory and a relisted one is still counted once.
+ *
+ * @note A file rewritten in place does not change its directory's times, so its
+ *       new size is only seen once something else in the directory changes.
+ * @note A replayed directory reports none of its entries, so a scan that needs
+ *       every entry, with `-a`, `--top`, accounting, a filter or an `entry`
+ *       callback, does not read the cache, see `mdu_scan` in libmdu.h.
+ *
+ * File layout, native byte order, all offsets relative to the start of the file:
+ *   CacheHeader
+ *   CacheRecord[nrecords], sorted by (dev, ino)
+ *   CacheLink[nlinks]: for each record `nlinks` links starting at `first_link`
+ *   names: for each record `nnames` NUL terminated names starting at `names_offset`
+ *
+ * The file is memory-mapped for lookups and replaced atomically with `rename`
+ * after a scan, so a scan interrupted midway leaves the previous cache intact.
+ *
+ * @file cache.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Memory-mapped, mtime-keyed cache of directory totals.
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CACHE_MAGIC "MDUCACHE"
+#define CACHE_VERSION 2
+#define CACHE_CHUNK_RECORDS 4096
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t nrecords;
+    uint64_t links_offset;
+    uint64_t nlinks;
+    uint64_t names_offset;
+    uint64_t names_size;
+} CacheHeader;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t ctime_sec;
+    int64_t ctime_nsec;
+} CacheKey;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t blocks;
+} CacheLink;
+
+/**
+ * @note `own_blocks` holds the blocks of the directory's own files that have a
+ *       single link, the others are its links.
+ */
+typedef struct {
+    CacheKey key;
+    int64_t own_blocks;
+    int64_t total;
+    uint64_t first_link;
+    uint64_t names_offset;
+    uint32_t nlinks;
+    uint32_t nnames;
+    uint32_t names_size;
+    uint32_t reserved;
+} CacheRecord;
+
+/**
+ * @note `fd` is -1 for a cache built with `collect_cache`, `map` is then allocated.
+ */
+typedef struct {
+    int fd;
+    void* map;
+    size_t size;
+    const CacheHeader* header;
+    const CacheRecord* records;
+    const CacheLink* links;
+    const char* names;
+} ScanCache;
+
+/**
+ * @note While collecting, `first_link` and `names_offset` of the record are
+ *       unused and the links and names are held in the allocated `links` and
+ *       `names` blocks. `links` grows to the next power of two as links are added.
+ */
+typedef struct PendingRecord {
+    CacheRecord rec;
+    CacheLink* links;
+    char* names;
+} PendingRecord;
+
+typedef struct {
+    PendingRecord** chunks;
+    size_t nchunks;
+    size_t count;
+    char* scratch;
+    size_t scratch_len;
+    size_t scratch_cap;
+    uint32_t scratch_names;
+} CacheCollector;
+
+/**
+ * @brief Fills in a cache key from a directory's status.
+ *
+ * @param key   The key to fill in.
+ * @param st    Status of the directory.
+ */
+void cache_key_from_stat(CacheKey* key, const struct stat* st);
+
+/**
+ * @brief Maps an existing cache file.
+ *
+ * @param path Path of the cache file.
+ *
+ * @return The loaded cache, or `NULL` if the file does not exist or is not a
+ *         valid cache, in which case the scan runs without one.
+ */
+ScanCache* open_cache(const char* path);
+
+/**
+ * @brief Builds a cache in memory from the records of all collectors.
+ *
+ * The result has the same layout as a cache file and is used the same way, it
+ * lets the daemon look up the directories of the scan it just ran.
+ *
+ * @param collectors    Array of collectors.
+ * @param n             Number of collectors.
+ *
+ * @return The cache, released with `close_cache`.
+ */
+ScanCache* collect_cache(CacheCollector collectors[], int n);
+
+/**
+ * @brief Unmaps the cache file, or frees a collected cache, and frees the handle.
+ *
+ * @param cache The cache, may be `NULL`.
+ */
+void close_cache(ScanCache* cache);
+
+/**
+ * @brief Looks up an unchanged directory.
+ *
+ * @param cache The cache, may be `NULL`.
+ * @param key   Identity and times of the directory.
+ *
+ * @return The record if the directory is in the cache with the same times,
+ *         otherwise `NULL`.
+ */
+const CacheRecord* cache_lookup(const ScanCache* cache, const CacheKey* key);
+
+/**
+ * @brief Returns the first of a record's names, the rest follow NUL separated.
+ *
+ * @param cache The cache the record was found in.
+ * @param rec   The record.
+ */
+const char* cache_names(const ScanCache* cache, const CacheRecord* rec);
+
+/**
+ * @brief Returns the links of a record.
+ *
+ * @param cache The cache the record was found in.
+ * @param rec   The record.
+ */
+const CacheLink* cache_links(const ScanCache* cache, const CacheRecord* rec);
+
+/**
+ * @brief Initializes an empty collector, one is owned by every worker.
+ *
+ * @param c The collector.
+ */
+void init_collector(CacheCollector* c);
+
+/**
+ * @brief Frees a collector and every record it holds.
+ *
+ * @param c The collector.
+ */
+void destroy_collector(CacheCollector* c);
+
+/**
+ * @brief Starts the record of a directory being listed.
+ *
+ * A worker lists one directory at a time, names added until `collector_end` belong
+ * to this record. The owning worker adds to `own_blocks`, or the record's links, as
+ * entries are sized.
+ *
+ * @param c     The collector.
+ * @param key   Identity and times of the directory.
+ *
+ * @return The record, whose address stays valid until the collector is destroyed
+ *         so the subtree total can be filled in when the directory completes.
+ */
+PendingRecord* collector_begin(CacheCollector* c, const CacheKey* key);
+
+/**
+ * @brief Adds the name of an entry scheduled from the current directory.
+ *
+ * @param c     The collector.
+ * @param name  Name of the entry.
+ */
+void collector_add_name(CacheCollector* c, const char* name);
+
+/**
+ * @brief Adds a file with several hard links to the record of its directory.
+ *
+ * Unlike names, links may be added after `collector_end`, files are sized
+ * asynchronously with `--engine=uring`.
+ *
+ * @param p         The record returned by `collector_begin`.
+ * @param dev       Device of the file.
+ * @param ino       Inode of the file.
+ * @param blocks    Size of the file in blocks.
+ */
+void collector_add_link(PendingRecord* p, dev_t dev, ino_t ino, long blocks);
+
+/**
+ * @brief Stores the names collected since `collector_begin` in the record.
+ *
+ * @param c     The collector.
+ * @param p     The record returned by `collector_begin`.
+ */
+void collector_end(CacheCollector* c, PendingRecord* p);
+
+/**
+ * @brief Writes the records of all collectors to a new cache file.
+ *
+ * The file is written next to `path` and renamed over it.
+ *
+ * @param path          Path of the cache file.
+ * @param collectors    Array of collectors.
+ * @param n             Number of collectors.
+ *
+ * @return 0 on success, -1 on failure with `errno` set.
+ */
+int write_cache(const char* path, CacheCollector collectors[], int n);
+
+#endif
@@ -0,0 +1,679 @@
+#include "daemon.h"
+static volatile sig_atomic_t stop_requested = 0;
+
+static void request_stop(int sig){
+    (void)sig;
+    stop_requested = 1;
+}
+
+static WatchNode* create_node(WatchNode* parent, const char* name){
+    size_t len = strlen(name);
+    WatchNode* node = malloc(sizeof(WatchNode) + len + 1);
+    if(node == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    node->parent        = parent;
+    node->children      = NULL;
+    node->nchildren     = 0;
+    node->capacity      = 0;
+    node->next_dirty    = NULL;
+    node->links         = NULL;
+    node->nlinks        = 0;
+    node->own           = 0;
+    node->linked        = 0;
+    node->total         = 0;
+    node->wd            = -1;
+    node->dirty         = false;
+    memcpy(node->name, name, len + 1);
+    return node;
+}
+
+static void add_child(WatchNode* parent, WatchNode* child){
+    if(parent->nchildren == parent->capacity){
+        size_t capacity = parent->capacity == 0 ? 4 : parent->capacity * 2;
+        WatchNode** children = realloc(parent->children, capacity * sizeof(WatchNode*));
+        if(children == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        parent->children = children;
+        parent->capacity = capacity;
+    }
+    parent->children[parent->nchildren++] = child;
+}
+
+static WatchNode* find_child(const WatchNode* parent, const char* name, size_t len){
+    for(size_t i = 0; i < parent->nchildren; i++){
+        WatchNode* child = parent->children[i];
+        if(strncmp(child->name, name, len) == 0 && child->name[len] == '\0') return child;
+    }
+    return NULL;
+}
+
+static void apply_delta(WatchNode* node, long delta){
+    for(; node != NULL; node = node->parent) node->total += delta;
+}
+
+static uint64_t hash_link(uint64_t dev, uint64_t ino){
+    //splitmix64 finalizer over both halves of the key, as in inoset.c.
+    uint64_t x = ino ^ (dev * 0x9e3779b97f4a7c15ULL);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+static DaemonLink** find_link(Daemon* d, uint64_t dev, uint64_t ino){
+    DaemonLink** slot = &d->links[hash_link(dev, ino) & (d->nbuckets - 1)];
+    while(*slot != NULL && ((*slot)->dev != dev || (*slot)->ino != ino)) slot = &(*slot)->next;
+    return slot;
+}
+
+static void grow_links(Daemon* d){
+    size_t nbuckets = d->nbuckets == 0 ? 1024 : d->nbuckets * 2;
+    DaemonLink** buckets = calloc(nbuckets, sizeof(DaemonLink*));
+    if(buckets == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < d->nbuckets; i++){
+        DaemonLink* next;
+        for(DaemonLink* l = d->links[i]; l != NULL; l = next){
+            next = l->next;
+            DaemonLink** bucket = &buckets[hash_link(l->dev, l->ino) & (nbuckets - 1)];
+            l->next = *bucket;
+            *bucket = l;
+        }
+    }
+    free(d->links);
+    d->links    = buckets;
+    d->nbuckets = nbuckets;
+}
+
+//`apply` passes the change on to the totals above `node`, not while it is being built.
+static void add_owned(WatchNode* node, long blocks, bool apply){
+    node->own       += blocks;
+    node->linked    += blocks;
+    if(apply) apply_delta(node, blocks);
+}
+
+//The first link found to a file counts its blocks.
+static void attach_link(Daemon* d, WatchNode* node, const CacheLink* key, bool apply){
+    if(d->nlinks >= d->nbuckets) grow_links(d);
+    DaemonLink** slot = find_link(d, key->dev, key->ino);
+    DaemonLink* l = *slot;
+    if(l == NULL){
+        l = calloc(1, sizeof(DaemonLink));
+        if(l == NULL){
+            perror("calloc");
+            exit(EXIT_FAILURE);
+        }
+        l->dev      = key->dev;
+        l->ino      = key->ino;
+        l->blocks   = key->blocks;
+        l->owner    = node;
+        *slot       = l;
+        d->nlinks++;
+        add_owned(node, l->blocks, apply);
+    }
+    if(l->nholders == l->capacity){
+        size_t capacity = l->capacity == 0 ? 2 : l->capacity * 2;
+        WatchNode** holders = realloc(l->holders, capacity * sizeof(WatchNode*));
+        if(holders == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        l->holders  = holders;
+        l->capacity = capacity;
+    }
+    l->holders[l->nholders++] = node;
+}
+
+//A file losing the last link of the directory counting it is counted by another holder.
+static void detach_link(Daemon* d, WatchNode* node, const CacheLink* key){
+    DaemonLink** slot = find_link(d, key->dev, key->ino);
+    DaemonLink* l = *slot;
+    for(size_t i = 0; i < l->nholders; i++){
+        if(l->holders[i] != node) continue;
+        l->holders[i] = l->holders[--l->nholders];
+        break;
+    }
+    if(l->owner != node) return;
+    for(size_t i = 0; i < l->nholders; i++){
+        if(l->holders[i] == node) return;
+    }
+
+    add_owned(node, -l->blocks, true);
+    if(l->nholders == 0){
+        *slot = l->next;
+        d->nlinks--;
+        free(l->holders);
+        free(l);
+        return;
+    }
+    l->owner = l->holders[0];
+    add_owned(l->owner, l->blocks, true);
+}
+
+//A file written through another of its links only dirties that link's directory.
+static void update_link(Daemon* d, const CacheLink* key){
+    DaemonLink* l = *find_link(d, key->dev, key->ino);
+    if(l->blocks == key->blocks) return;
+    add_owned(l->owner, key->blocks - l->blocks, true);
+    l->blocks = key->blocks;
+}
+
+static int compare_link(const void* a, const void* b){
+    const CacheLink* x = a;
+    const CacheLink* y = b;
+    if(x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+    if(x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+    return 0;
+}
+
+//Replaces the links of `node` with those listed now, the list is taken over.
+static void set_links(Daemon* d, WatchNode* node, LinkList* list, bool apply){
+    if(list->n > 1) qsort(list->links, list->n, sizeof(CacheLink), compare_link);
+    size_t i = 0, j = 0;
+    while(i < node->nlinks || j < list->n){
+        int c = i == node->nlinks ? 1 : j == list->n ? -1 : compare_link(&node->links[i], &list->links[j]);
+        if(c < 0){
+            detach_link(d, node, &node->links[i++]);
+        } else if(c > 0){
+            attach_link(d, node, &list->links[j++], apply);
+        } else {
+            if(apply) update_link(d, &list->links[j]);
+            i++;
+            j++;
+        }
+    }
+    free(node->links);
+    node->links     = list->links;
+    node->nlinks    = list->n;
+}
+
+static void add_link(LinkList* list, uint64_t dev, uint64_t ino, long blocks){
+    if(list->n == list->capacity){
+        size_t capacity = list->capacity == 0 ? 16 : list->capacity * 2;
+        CacheLink* links = realloc(list->links, capacity * sizeof(CacheLink));
+        if(links == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        list->links     = links;
+        list->capacity  = capacity;
+    }
+    list->links[list->n++] = (CacheLink){ .dev = dev, .ino = ino, .blocks = blocks };
+}
+
+static char* node_path(const WatchNode* node){
+    size_t len = 0;
+    for(const WatchNode* n = node; n != NULL; n = n->parent) len += strlen(n->name) + 1;
+
+    char* path = malloc(len);
+    if(path == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    size_t end = len - 1;
+    path[end] = '\0';
+    for(const WatchNode* n = node; n != NULL; n = n->parent){
+        size_t n_len = strlen(n->name);
+        end -= n_len;
+        memcpy(path + end, n->name, n_len);
+        if(n->parent != NULL) path[--end] = '/';
+    }
+    return path;
+}
+
+static void watch_node(Daemon* d, WatchNode* node, int fd){
+    char proc_path[64];
+    snprintf(proc_path, sizeof(proc_path), "/proc/self/fd/%d", fd);
+    int wd = inotify_add_watch(d->inotify_fd, proc_path, DAEMON_WATCH_MASK);
+    if(wd == -1){
+        char* path = node_path(node);
+        fprintf(stderr, "mdu: cannot watch %s: %s\n", path, strerror(errno));
+        free(path);
+        return;
+    }
+
+    if((size_t)wd >= d->nwatches){
+        size_t n = d->nwatches == 0 ? 1024 : d->nwatches;
+        while(n <= (size_t)wd) n *= 2;
+        WatchNode** watches = realloc(d->watches, n * sizeof(WatchNode*));
+        if(watches == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        memset(watches + d->nwatches, 0, (n - d->nwatches) * sizeof(WatchNode*));
+        d->watches  = watches;
+        d->nwatches = n;
+    }
+    d->watches[wd]  = node;
+    node->wd        = wd;
+}
+
+//A subtree is unlinked from its parent first, so the blocks of files moving between
+//the nodes being freed never reach the rest of the tree.
+static void free_tree(Daemon* d, WatchNode* node){
+    for(size_t i = 0; i < node->nchildren; i++) free_tree(d, node->children[i]);
+    for(size_t i = 0; i < node->nlinks; i++) detach_link(d, node, &node->links[i]);
+    if(node->wd >= 0 && d->watches[node->wd] == node){
+        inotify_rm_watch(d->inotify_fd, node->wd);
+        d->watches[node->wd] = NULL;
+    }
+    if(node->dirty){
+        WatchNode** link = &d->dirty;
+        while(*link != node) link = &(*link)->next_dirty;
+        *link = node->next_dirty;
+    }
+    free(node->links);
+    free(node->children);
+    free(node);
+}
+
+//A file with several links is added to `links` instead of being counted.
+static long entry_blocks(int dir_fd, const char* name, bool* is_dir, LinkList* links){
+    struct stat st;
+    if(fstatat(dir_fd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) return 0;
+    *is_dir = S_ISDIR(st.st_mode);
+    if(!S_ISREG(st.st_mode) && !S_ISLNK(st.st_mode)) return 0;
+    if(st.st_nlink > 1){
+        add_link(links, st.st_dev, st.st_ino, st.st_blocks);
+        return 0;
+    }
+    return st.st_blocks;
+}
+
+static WatchNode* build_dir(Daemon* d, WatchNode* parent, int parent_fd, const char* name, const ScanCache* scan);
+
+static void build_children(Daemon* d, WatchNode* node, int fd, const char* names, uint32_t nnames, const ScanCache* scan, LinkList* links){
+    for(uint32_t i = 0; i < nnames; i++){
+        bool is_dir = false;
+        node->own += entry_blocks(fd, names, &is_dir, links);
+        if(is_dir){
+            WatchNode* child = build_dir(d, node, fd, names, scan);
+            if(child != NULL) add_child(node, child);
+        }
+        names += strlen(names) + 1;
+    }
+}
+
+static void list_dir(Daemon* d, WatchNode* node, int fd, const ScanCache* scan, LinkList* links){
+    CacheCollector names;
+    init_collector(&names);
+
+    LinuxDirent64* dp;
+    dirreader_open(&d->reader, fd);
+    while((dp = dirreader_next(&d->reader)) != NULL){
+        switch (dp->d_type) {
+            case DT_REG:
+            case DT_LNK: {
+                bool is_dir = false;
+                node->own += entry_blocks(fd, dp->d_name, &is_dir, links);
+                break;
+            }
+            case DT_CHR:
+            case DT_BLK:
+            case DT_FIFO:
+                break;
+            default:
+                collector_add_name(&names, dp->d_name);
+                break;
+        }
+    }
+    //The reader is shared, subdirectories are only listed once this one is done.
+    build_children(d, node, fd, names.scratch, names.scratch_names, scan, links);
+    destroy_collector(&names);
+}
+
+static WatchNode* build_dir(Daemon* d, WatchNode* parent, int parent_fd, const char* name, const ScanCache* scan){
+    struct stat st;
+    if(fstatat(parent_fd, name, &st, AT_SYMLINK_NOFOLLOW) == -1) return NULL;
+
+    WatchNode* node = create_node(parent, name);
+    node->own = st.st_blocks;
+    if(!S_ISDIR(st.st_mode)){
+        node->total = node->own;
+        return node;
+    }
+
+    int fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if(fd == -1){
+        node->total = node->own;
+        return node;
+    }
+    watch_node(d, node, fd);
+
+    CacheKey key;
+    cache_key_from_stat(&key, &st);
+    const CacheRecord* rec = cache_lookup(scan, &key);
+    LinkList links = { NULL, 0, 0 };
+    if(rec != NULL){
+        node->own += rec->own_blocks;
+        const CacheLink* cached = cache_links(scan, rec);
+        for(uint32_t i = 0; i < rec->nlinks; i++) add_link(&links, cached[i].dev, cached[i].ino, cached[i].blocks);
+        build_children(d, node, fd, cache_names(scan, rec), rec->nnames, scan, &links);
+    } else {
+        list_dir(d, node, fd, scan, &links);
+    }
+    close(fd);
+    set_links(d, node, &links, false);
+
+    node->total = node->own;
+    for(size_t i = 0; i < node->nchildren; i++) node->total += node->children[i]->total;
+    return node;
+}
+
+static void build_roots(Daemon* d, char* paths[], const ScanCache* scan){
+    for(int i = 0; i < d->nroots; i++){
+        d->roots[i] = build_dir(d, NULL, AT_FDCWD, paths[i], scan);
+        if(d->roots[i] == NULL){
+            fprintf(stderr, "mdu: cannot watch %s: %s\n", paths[i], strerror(errno));
+            d->roots[i] = create_node(NULL, paths[i]);
+        }
+    }
+}
+
+static void rebuild(Daemon* d){
+    fprintf(stderr, "mdu: inotify queue overflowed, rescanning.\n");
+    char* paths[d->nroots];
+    for(int i = 0; i < d->nroots; i++){
+        paths[i] = strdup(d->roots[i]->name);
+        free_tree(d, d->roots[i]);
+    }
+    build_roots(d, paths, NULL);
+    for(int i = 0; i < d->nroots; i++) free(paths[i]);
+}
+
+static void refresh_own(Daemon* d, WatchNode* node){
+    char* path = node_path(node);
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    free(path);
+    if(fd == -1) return;
+
+    struct stat st;
+    long own = 0;
+    LinkList links = { NULL, 0, 0 };
+    if(fstat(fd, &st) == 0) own = st.st_blocks;
+
+    LinuxDirent64* dp;
+    dirreader_open(&d->reader, fd);
+    while((dp = dirreader_next(&d->reader)) != NULL){
+        if(dp->d_type == DT_DIR || dp->d_type == DT_CHR || dp->d_type == DT_BLK || dp->d_type == DT_FIFO) continue;
+        bool is_dir = false;
+        own += entry_blocks(fd, dp->d_name, &is_dir, &links);
+    }
+    close(fd);
+
+    set_links(d, node, &links, true);
+    own += node->linked;
+    apply_delta(node, own - node->own);
+    node->own = own;
+}
+
+static void mark_dirty(Daemon* d, WatchNode* node){
+    if(node->dirty) return;
+    node->dirty         = true;
+    node->next_dirty    = d->dirty;
+    d->dirty            = node;
+}
+
+static void remove_subdir(Daemon* d, WatchNode* node, const char* name){
+    WatchNode* child = find_child(node, name, strlen(name));
+    if(child == NULL) return;
+    for(size_t i = 0; i < node->nchildren; i++){
+        if(node->children[i] != child) continue;
+        node->children[i] = node->children[--node->nchildren];
+        break;
+    }
+    apply_delta(node, -child->total);
+    child->parent = NULL;
+    free_tree(d, child);
+}
+
+static void add_subdir(Daemon* d, WatchNode* node, const char* name){
+    remove_subdir(d, node, name);
+
+    char* path = node_path(node);
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    free(path);
+    if(fd == -1) return;
+
+    WatchNode* child = build_dir(d, node, fd, name, NULL);
+    close(fd);
+    if(child == NULL) return;
+    add_child(node, child);
+    apply_delta(node, child->total);
+}
+
+static void handle_event(Daemon* d, const struct inotify_event* ev){
+    if(ev->mask & IN_Q_OVERFLOW){
+        rebuild(d);
+        return;
+    }
+    if(ev->wd < 0 || (size_t)ev->wd >= d->nwatches) return;
+    WatchNode* node = d->watches[ev->wd];
+    if(node == NULL) return;
+
+    if(ev->mask & IN_IGNORED){
+        d->watches[ev->wd] = NULL;
+        node->wd = -1;
+        return;
+    }
+    //The parent's IN_DELETE or IN_MOVED_FROM removes the node.
+    if(ev->mask & IN_DELETE_SELF) return;
+
+    if((ev->mask & IN_ISDIR) && ev->len > 0){
+        if(ev->mask & (IN_DELETE | IN_MOVED_FROM)) remove_subdir(d, node, ev->name);
+        else if(ev->mask & (IN_CREATE | IN_MOVED_TO)) add_subdir(d, node, ev->name);
+    }
+    mark_dirty(d, node);
+}
+
+static void read_events(Daemon* d){
+    _Alignas(struct inotify_event) char buffer[DAEMON_EVENT_BUFFER];
+    ssize_t len;
+    while((len = read(d->inotify_fd, buffer, sizeof(buffer))) > 0){
+        for(char* p = buffer; p < buffer + len; ){
+            const struct inotify_event* ev = (const struct inotify_event*)p;
+            handle_event(d, ev);
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+
+    while(d->dirty != NULL){
+        WatchNode* node = d->dirty;
+        d->dirty            = node->next_dirty;
+        node->dirty         = false;
+        node->next_dirty    = NULL;
+        refresh_own(d, node);
+    }
+}
+
+WatchNode* daemon_lookup(Daemon* d, const char* path){
+    size_t len = strlen(path);
+    while(len > 1 && path[len - 1] == '/') len--;
+
+    for(int i = 0; i < d->nroots; i++){
+        const char* root = d->roots[i]->name;
+        size_t root_len = strlen(root);
+        while(root_len > 1 && root[root_len - 1] == '/') root_len--;
+        if(len < root_len || strncmp(path, root, root_len) != 0) continue;
+        if(len > root_len && path[root_len] != '/' && root[root_len - 1] != '/') continue;
+
+        WatchNode* node = d->roots[i];
+        const char* p   = path + root_len;
+        const char* end = path + len;
+        while(node != NULL && p < end){
+            while(p < end && *p == '/') p++;
+            const char* slash = p;
+            while(slash < end && *slash != '/') slash++;
+            if(slash > p) node = find_child(node, p, slash - p);
+            p = slash;
+        }
+        if(node != NULL) return node;
+    }
+    return NULL;
+}
+
+static int open_socket(const char* socket_path){
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(strlen(socket_path) >= sizeof(addr.sun_path)){
+        fprintf(stderr, "mdu: socket path too long, %s\n", socket_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(fd == -1){
+        perror("socket");
+        return -1;
+    }
+    struct stat st;
+    if(lstat(socket_path, &st) == 0){
+        if(!S_ISSOCK(st.st_mode)){
+            errno = EEXIST;
+            fprintf(stderr, "mdu: %s: %s and is not a socket, refusing to replace it\n", socket_path, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        unlink(socket_path);
+    }
+    if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1){
+        perror(socket_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void close_client(DaemonClient* c){
+    close(c->fd);
+    c->fd   = -1;
+    c->len  = 0;
+}
+
+static void accept_clients(Daemon* d){
+    int fd;
+    while((fd = accept(d->listen_fd, NULL, NULL)) != -1){
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        int i = 0;
+        while(i < DAEMON_MAX_CLIENTS && d->clients[i].fd != -1) i++;
+        if(i == DAEMON_MAX_CLIENTS){
+            close(fd);
+            continue;
+        }
+        d->clients[i].fd    = fd;
+        d->clients[i].len   = 0;
+    }
+}
+
+static bool answer(Daemon* d, DaemonClient* c, const char* path){
+    char reply[DAEMON_REQUEST_MAX + 32];
+    WatchNode* node = daemon_lookup(d, path);
+    int len = node == NULL ? snprintf(reply, sizeof(reply), "error\t%s\n", path)
+                           : snprintf(reply, sizeof(reply), "%ld\t%s\n", node->total, path);
+    return send(c->fd, reply, len, MSG_NOSIGNAL) == len;
+}
+
+static void serve_client(Daemon* d, DaemonClient* c){
+    ssize_t n = read(c->fd, c->buffer + c->len, sizeof(c->buffer) - c->len);
+    if(n == -1 && (errno == EAGAIN || errno == EINTR)) return;
+    if(n <= 0){
+        close_client(c);
+        return;
+    }
+    c->len += n;
+
+    size_t start = 0;
+    for(size_t i = 0; i < c->len; i++){
+        if(c->buffer[i] != '\n') continue;
+        c->buffer[i] = '\0';
+        if(i > start && c->buffer[i - 1] == '\r') c->buffer[i - 1] = '\0';
+        if(!answer(d, c, c->buffer + start)){
+            close_client(c);
+            return;
+        }
+        start = i + 1;
+    }
+    memmove(c->buffer, c->buffer + start, c->len - start);
+    c->len -= start;
+    if(c->len == sizeof(c->buffer)) close_client(c);
+}
+
+int run_daemon(const char* socket_path, char* paths[], int npaths, const ScanCache* scan){
+    Daemon d;
+    memset(&d, 0, sizeof(d));
+    for(int i = 0; i < DAEMON_MAX_CLIENTS; i++) d.clients[i].fd = -1;
+
+    d.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(d.inotify_fd == -1){
+        perror("inotify_init1");
+        return EXIT_FAILURE;
+    }
+    d.listen_fd = open_socket(socket_path);
+    if(d.listen_fd == -1){
+        close(d.inotify_fd);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = request_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    init_dirreader(&d.reader, DIRREAD_BUFFER_SIZE);
+    d.nroots = npaths;
+    d.roots = malloc(npaths * sizeof(WatchNode*));
+    if(d.roots == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    build_roots(&d, paths, scan);
+
+    while(!stop_requested){
+        struct pollfd fds[2 + DAEMON_MAX_CLIENTS];
+        DaemonClient* polled[DAEMON_MAX_CLIENTS];
+        int nfds = 2;
+        fds[0] = (struct pollfd){ .fd = d.inotify_fd, .events = POLLIN };
+        fds[1] = (struct pollfd){ .fd = d.listen_fd, .events = POLLIN };
+        for(int i = 0; i < DAEMON_MAX_CLIENTS; i++){
+            if(d.clients[i].fd == -1) continue;
+            polled[nfds - 2] = &d.clients[i];
+            fds[nfds++] = (struct pollfd){ .fd = d.clients[i].fd, .events = POLLIN };
+        }
+
+        if(poll(fds, nfds, -1) == -1){
+            if(errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        if(fds[0].revents) read_events(&d);
+        if(fds[1].revents) accept_clients(&d);
+        for(int i = 2; i < nfds; i++){
+            if(fds[i].revents) serve_client(&d, polled[i - 2]);
+        }
+    }
+
+    for(int i = 0; i < DAEMON_MAX_CLIENTS; i++){
+        if(d.clients[i].fd != -1) close_client(&d.clients[i]);
+    }
+    for(int i = 0; i < d.nroots; i++) free_tree(&d, d.roots[i]);
+    free(d.roots);
+    free(d.links);
+    free(d.watches);
+    destroy_dirreader(&d.reader);
+    close(d.listen_fd);
+    close(d.inotify_fd);
+    unlink(socket_path);
+    return EXIT_SUCCESS;
+}
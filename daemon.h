@@ -0,0 +1,157 @@
+/**
+ *
+ * This file defines the watch daemon started with `--daemon=SOCKET`. After the
+ * initial parallel scan the daemon keeps a tree of every directory below the
+ * command line paths, each node holding the blocks of the directory's own entries
+ * and its subtree total, and watches every directory with inotify.
+ *
+ * The tree is built from the records collected during the scan, see cache.h, so
+ * building it only stats and watches directories. Changes are applied as deltas
+ * up the chain of parents:
+ * - A directory created or moved in is scanned and its total added.
+ * - A directory removed or moved out has its total subtracted.
+ * - Any other change marks the directory dirty, after each batch of events every
+ *   dirty directory's own entries are summed again, which coalesces bursts of
+ *   writes to a single listing.
+ * A queue overflow rebuilds the whole tree.
+ *
+ * Clients connect to the Unix domain socket and send one path per line, each is
+ * answered with "<blocks>\t<path>\n" from the tree, or "error\t<path>\n" if the
+ * path is not a watched directory. Answering a query does not touch the file
+ * system.
+ *
+ * A file with several hard links is counted once in the whole tree. The daemon
+ * keeps every such inode with the directories linking it and counts its blocks
+ * in one of them. When that directory loses its link they move to another
+ * directory still linking the file, and leave the tree with its last link.
+ *
+ * @note A file rewritten without changing its size is only seen as a dirty
+ *       directory, which costs one listing.
+ *
+ * @file daemon.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief inotify-backed daemon serving live directory totals over a socket.
+ */
+
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "du_worker.h"
+#include "cache.h"
+#include "dirread.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+#define DAEMON_MAX_CLIENTS 64
+#define DAEMON_REQUEST_MAX 4096
+#define DAEMON_EVENT_BUFFER (64 * 1024)
+
+#define DAEMON_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | \
+                           IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK)
+
+/**
+ * @note `own` holds the blocks of the directory itself, of its non-directory
+ *       entries with a single link and of the hard-linked files counted in it,
+ *       `linked` the last of these. `total` adds the totals of `children`.
+ * @note `links` holds every hard-linked file of the directory sorted by
+ *       (dev, ino), once per link.
+ */
+typedef struct WatchNode {
+    struct WatchNode* parent;
+    struct WatchNode** children;
+    size_t nchildren;
+    size_t capacity;
+    struct WatchNode* next_dirty;
+    CacheLink* links;
+    size_t nlinks;
+    long own;
+    long linked;
+    long total;
+    int wd;
+    bool dirty;
+    char name[];
+} WatchNode;
+
+/**
+ * @note `holders` holds the directories linking the file, once per link, its
+ *       blocks are counted in `owner`, one of them.
+ */
+typedef struct DaemonLink {
+    struct DaemonLink* next;
+    uint64_t dev;
+    uint64_t ino;
+    long blocks;
+    WatchNode* owner;
+    WatchNode** holders;
+    size_t nholders;
+    size_t capacity;
+} DaemonLink;
+
+typedef struct {
+    CacheLink* links;
+    size_t n;
+    size_t capacity;
+} LinkList;
+
+typedef struct {
+    int fd;
+    size_t len;
+    char buffer[DAEMON_REQUEST_MAX];
+} DaemonClient;
+
+typedef struct {
+    WatchNode** roots;
+    int nroots;
+    int inotify_fd;
+    int listen_fd;
+    WatchNode** watches;
+    size_t nwatches;
+    WatchNode* dirty;
+    DaemonLink** links;
+    size_t nbuckets;
+    size_t nlinks;
+    DaemonClient clients[DAEMON_MAX_CLIENTS];
+    DirReader reader;
+} Daemon;
+
+/**
+ * @brief Builds the watch tree and serves queries until SIGINT or SIGTERM.
+ *
+ * @param socket_path   Path of the Unix domain socket to listen on, an existing
+ *                      socket file is replaced and removed again on exit. Any
+ *                      other file at the path is left alone and the daemon
+ *                      fails with `EEXIST`.
+ * @param paths         The command line paths.
+ * @param npaths        Number of paths.
+ * @param scan          Records of the initial scan, directories without one are
+ *                      listed while building the tree.
+ *
+ * @return `EXIT_SUCCESS`, or `EXIT_FAILURE` if the socket or inotify could not
+ *         be set up.
+ */
+int run_daemon(const char* socket_path, char* paths[], int npaths, const ScanCache* scan);
+
+/**
+ * @brief Finds the node of a watched directory.
+ *
+ * @param d     The daemon.
+ * @param path  Path as given on the command line followed by any components,
+ *              trailing slashes are ignored.
+ *
+ * @return The node, or `NULL` if the path is not a watched directory.
+ */
+WatchNode* daemon_lookup(Daemon* d, const char* path);
+
+#endif
@@ -0,0 +1,118 @@
+#include "deque.h"
+static DequeArray* create_array(long capacity){
+    DequeArray* a = malloc(sizeof(DequeArray) + capacity * sizeof(_Atomic(Entry*)));
+    if(a == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    a->capacity = capacity;
+    a->retired  = NULL;
+    return a;
+}
+
+static DequeArray* grow_array(DequeArray* old, long top, long bottom){
+    DequeArray* a = create_array(old->capacity * 2);
+    for(long i = top; i < bottom; i++){
+        Entry* e = atomic_load_explicit(&old->slots[i % old->capacity], memory_order_relaxed);
+        atomic_store_explicit(&a->slots[i % a->capacity], e, memory_order_relaxed);
+    }
+    a->retired = old;
+    return a;
+}
+
+void init_deque(WorkDeque* d){
+    atomic_init(&d->top, 0);
+    atomic_init(&d->bottom, 0);
+    atomic_init(&d->array, create_array(DEQUE_INITIAL_CAPACITY));
+}
+
+void destroy_deque(WorkDeque* d){
+    Entry* e;
+    while((e = deque_pop(d)) != NULL) destroy_entry(NULL, e);
+
+    DequeArray* a = atomic_load(&d->array);
+    while(a != NULL){
+        DequeArray* next = a->retired;
+        free(a);
+        a = next;
+    }
+    atomic_store(&d->array, NULL);
+}
+
+void deque_push(WorkDeque* d, Entry* e){
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    DequeArray* a = atomic_load_explicit(&d->array, memory_order_relaxed);
+
+    if(b - t > a->capacity - 1){
+        a = grow_array(a, t, b);
+        atomic_store_explicit(&d->array, a, memory_order_release);
+    }
+    atomic_store_explicit(&a->slots[b % a->capacity], e, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+}
+
+void deque_push_batch(WorkDeque* d, Entry* const entries[], int n){
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    DequeArray* a = atomic_load_explicit(&d->array, memory_order_relaxed);
+
+    if(b - t + n > a->capacity){
+        while(b - t + n > a->capacity) a = grow_array(a, t, b);
+        atomic_store_explicit(&d->array, a, memory_order_release);
+    }
+    for(int i = 0; i < n; i++){
+        atomic_store_explicit(&a->slots[(b + i) % a->capacity], entries[i], memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&d->bottom, b + n, memory_order_relaxed);
+}
+
+Entry* deque_pop(WorkDeque* d){
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    DequeArray* a = atomic_load_explicit(&d->array, memory_order_relaxed);
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    Entry* e = NULL;
+    if(t <= b){
+        e = atomic_load_explicit(&a->slots[b % a->capacity], memory_order_relaxed);
+        if(t == b){
+            //Last entry, race any thief for it.
+            if(!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+                    memory_order_seq_cst, memory_order_relaxed)){
+                e = NULL;
+            }
+            atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return e;
+}
+
+Entry* deque_steal(WorkDeque* d, int* contended){
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    *contended = 0;
+    if(t >= b) return NULL;
+
+    DequeArray* a = atomic_load_explicit(&d->array, memory_order_acquire);
+    Entry* e = atomic_load_explicit(&a->slots[t % a->capacity], memory_order_relaxed);
+    if(!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1,
+            memory_order_seq_cst, memory_order_relaxed)){
+        *contended = 1;
+        return NULL;
+    }
+    return e;
+}
+
+long deque_size(WorkDeque* d){
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+    return b > t ? b - t : 0;
+}
@@ -0,0 +1,118 @@
+/**
+ *
+ * This file defines a work-stealing deque, one of which is owned by every worker.
+ * The owning thread pushes and pops entries at the bottom (LIFO) without taking
+ * any lock, while idle threads steal entries from the top (FIFO) using a single
+ * compare-and-swap. Stealing the oldest entry means thieves tend to take the
+ * largest unexplored subtrees, while the owner stays on the directory it just read.
+ *
+ * This implementation follows the Chase-Lev deque as formulated for C11 atomics in:
+ * N. M. Lê, A. Pop, A. Cohen, F. Zappa Nardelli,
+ * "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP 2013.
+ *
+ * @file deque.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Lock-free work-stealing deque of queue entries.
+ */
+
+#ifndef DEQUE_H
+#define DEQUE_H
+
+#include "queue.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+
+#define DEQUE_INITIAL_CAPACITY 256
+
+/**
+ * @note Arrays replaced by a resize are kept on the `retired` list since a thief
+ *       may still be reading from them, they are released by `destroy_deque`.
+ */
+typedef struct DequeArray {
+    long capacity;
+    struct DequeArray* retired;
+    _Atomic(Entry*) slots[];
+} DequeArray;
+
+typedef struct WorkDeque {
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    _Atomic(DequeArray*) array;
+} WorkDeque;
+
+/**
+ * @brief Initializes an empty deque.
+ *
+ * @param d Pointer to the deque to initialize.
+ *
+ * @note Terminates the program if the initial array cannot be allocated.
+ */
+void init_deque(WorkDeque* d);
+
+/**
+ * @brief Frees the deque's arrays and every entry still stored in it.
+ *
+ * @param d Pointer to the deque, no thread may access it concurrently.
+ */
+void destroy_deque(WorkDeque* d);
+
+/**
+ * @brief Pushes an entry at the bottom of the deque.
+ *
+ * Grows the backing array when it is full.
+ *
+ * @param d Pointer to the deque.
+ * @param e The entry to push.
+ *
+ * @note Must only be called by the thread owning the deque.
+ */
+void deque_push(WorkDeque* d, Entry* e);
+
+/**
+ * @brief Pushes several entries onto the bottom of the deque at once.
+ *
+ * The entries become visible to thieves together, with a single release of 
+ * `bottom`, and the array is grown at most once.
+ *
+ * @param d         Pointer to the deque.
+ * @param entries   The entries, pushed in order.
+ * @param n         Number of entries.
+ *
+ * @note Must only be called by the thread owning the deque.
+ */
+void deque_push_batch(WorkDeque* d, Entry* const entries[], int n);
+
+/**
+ * @brief Pops the most recently pushed entry.
+ *
+ * @param d Pointer to the deque.
+ *
+ * @return The entry at the bottom of the deque, or `NULL` if it is empty.
+ *
+ * @note Must only be called by the thread owning the deque.
+ */
+Entry* deque_pop(WorkDeque* d);
+
+/**
+ * @brief Steals the oldest entry from the deque.
+ *
+ * @param d         Pointer to the deque to steal from.
+ * @param contended Set to 1 if the steal lost a race with another thread,
+ *                  in which case the deque may still hold entries.
+ *
+ * @return The entry at the top of the deque, or `NULL` if none was taken.
+ *
+ * @note Safe to call from any thread.
+ */
+Entry* deque_steal(WorkDeque* d, int* contended);
+
+/**
+ * @brief Returns an estimate of the number of entries in the deque.
+ *
+ * @param d Pointer to the deque.
+ */
+long deque_size(WorkDeque* d);
+
+#endif
@@ -0,0 +1,51 @@
+#include "dirread.h"
+void init_dirreader(DirReader* r, size_t size){
+    r->buffer = malloc(size);
+    if(r->buffer == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    r->size = size;
+    r->pos  = 0;
+    r->end  = 0;
+    r->fd   = -1;
+    r->calls = 0;
+}
+
+void destroy_dirreader(DirReader* r){
+    free(r->buffer);
+    r->buffer = NULL;
+}
+
+void dirreader_open(DirReader* r, int fd){
+    r->fd  = fd;
+    r->pos = 0;
+    r->end = 0;
+}
+
+LinuxDirent64* dirreader_next(DirReader* r){
+    while(1){
+        if(r->pos >= r->end){
+            if(r->fd == -1) return NULL;
+
+            long n = syscall(SYS_getdents64, r->fd, r->buffer, r->size);
+            STATS_INC(r->calls);
+            if(n <= 0){
+                //End of directory, or an error left in errno.
+                r->fd = -1;
+                return NULL;
+            }
+            r->pos = 0;
+            r->end = n;
+        }
+
+        LinuxDirent64* d = (LinuxDirent64*)(r->buffer + r->pos);
+        r->pos += d->d_reclen;
+
+        //skip '.','..'
+        if(d->d_name[0] == '.' && (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0'))){
+            continue;
+        }
+        return d;
+    }
+}
@@ -0,0 +1,105 @@
+/**
+ *
+ * This file defines `DirReader`, a directory listing layer built directly on the
+ * `getdents64` system call. Each worker owns one reader whose buffer is allocated
+ * once and reused for every directory the worker lists. The buffer is sized so
+ * that a directory with hundreds of thousands of entries is read in a handful of
+ * system calls, compared to the small internal buffer used by `readdir`, and no
+ * `DIR` stream has to be allocated and freed for every directory.
+ *
+ * The reader does not own the descriptor it reads from, so the descriptor held
+ * by a `DirRef` is used both for listing and for resolving the entries.
+ *
+ * @file dirread.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Buffered getdents64 directory reader.
+ */
+
+#ifndef DIRREAD_H
+#define DIRREAD_H
+
+#include "stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+
+#define DIRREAD_BUFFER_SIZE (256 * 1024)
+
+/**
+ * @note Layout of the records returned by `getdents64`, see getdents(2).
+ */
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+
+/**
+ * @note `calls` counts the `getdents64` calls made, only in builds with `MDU_STATS`.
+ */
+typedef struct {
+    char* buffer;
+    size_t size;
+    size_t pos;
+    size_t end;
+    int fd;
+    long calls;
+} DirReader;
+
+/**
+ * @brief Allocates the reader's buffer.
+ *
+ * @param r     Pointer to the reader to initialize.
+ * @param size  Size of the buffer in bytes, `DIRREAD_BUFFER_SIZE` for workers.
+ *
+ * @note Terminates the program if the buffer cannot be allocated.
+ */
+void init_dirreader(DirReader* r, size_t size);
+
+/**
+ * @brief Frees the reader's buffer.
+ *
+ * @param r Pointer to the reader.
+ */
+void destroy_dirreader(DirReader* r);
+
+/**
+ * @brief Starts listing the directory open on `fd`.
+ *
+ * @param r     Pointer to the reader, any previous listing is abandoned.
+ * @param fd    Descriptor of a directory positioned at its first entry, not owned by the reader.
+ */
+void dirreader_open(DirReader* r, int fd);
+
+/**
+ * @brief Returns the next entry of the directory, skipping `.` and `..`.
+ *
+ * @param r Pointer to the reader.
+ *
+ * @return The next entry, valid until the following call, or `NULL` at the end
+ *         of the directory or on error, in which case `errno` is non-zero.
+ *
+ * @note Set `errno` to zero before the first call to tell the two apart.
+ */
+LinuxDirent64* dirreader_next(DirReader* r);
+
+/**
+ * @brief Returns whether every entry read so far was returned.
+ *
+ * The next call to `dirreader_next` then reads from the directory again, so the 
+ * listing may be handed to another reader on the same descriptor.
+ *
+ * @param r Pointer to the reader.
+ */
+static inline int dirreader_drained(const DirReader* r){
+    return r->pos >= r->end;
+}
+
+#endif
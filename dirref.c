@@ -0,0 +1,94 @@
+#include "dirref.h"
+DirRef* create_dirref(DirRef* parent, const char* name, int fd){
+    size_t len = strlen(name);
+    DirRef* dir = malloc(sizeof(DirRef) + len + 1);
+    if(dir == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    atomic_init(&dir->refs, 1);
+    atomic_init(&dir->users, 1);
+    atomic_init(&dir->pending, 1);
+    atomic_init(&dir->total, 0);
+    atomic_init(&dir->entries, 0);
+    dir->dev    = 0;
+    dir->ino    = 0;
+    dir->fd     = fd;
+    dir->depth  = parent == NULL ? 0 : parent->depth + 1;
+    dir->parent = parent;
+    dir->record = NULL;
+    init_arena(&dir->names);
+    memcpy(dir->name, name, len + 1);
+
+    if(parent != NULL) atomic_fetch_add(&parent->refs, 1);
+    return dir;
+}
+
+void acquire_dirref(DirRef* dir){
+    if(dir == NULL) return;
+    atomic_fetch_add_explicit(&dir->refs, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&dir->users, 1, memory_order_relaxed);
+}
+
+void dirref_expect(DirRef* dir){
+    atomic_fetch_add_explicit(&dir->pending, 1, memory_order_relaxed);
+}
+
+bool dirref_child_done(DirRef* dir, long size){
+    if(size != 0) atomic_fetch_add_explicit(&dir->total, size, memory_order_relaxed);
+    return atomic_fetch_sub_explicit(&dir->pending, 1, memory_order_acq_rel) == 1;
+}
+
+static void unref_dirref(DirRef* dir){
+    while(dir != NULL && atomic_fetch_sub(&dir->refs, 1) == 1){
+        DirRef* parent = dir->parent;
+        destroy_arena(&dir->names);
+        free(dir);
+        dir = parent;
+    }
+}
+
+void release_dirref(DirRef* dir){
+    if(dir == NULL) return;
+    if(atomic_fetch_sub(&dir->users, 1) == 1){
+        close(dir->fd);
+        dir->fd     = -1;
+    }
+    unref_dirref(dir);
+}
+
+int dirref_fd(const DirRef* dir){
+    return dir == NULL ? AT_FDCWD : dir->fd;
+}
+
+size_t path_length(const DirRef* parent, const char* name){
+    size_t len = strlen(name);
+    for(const DirRef* d = parent; d != NULL; d = d->parent) len += strlen(d->name) + 1;
+    return len;
+}
+
+void write_path(char* out, size_t len, const DirRef* parent, const char* name){
+    size_t end = len;
+    size_t n = strlen(name);
+    end -= n;
+    memcpy(out + end, name, n);
+    for(const DirRef* d = parent; d != NULL; d = d->parent){
+        out[--end] = '/';
+        n = strlen(d->name);
+        end -= n;
+        memcpy(out + end, d->name, n);
+    }
+}
+
+char* build_path(const DirRef* parent, const char* name){
+    size_t len = path_length(parent, name);
+    char* path = malloc(len + 1);
+    if(path == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    write_path(path, len, parent, name);
+    path[len] = '\0';
+    return path;
+}
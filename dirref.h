@@ -0,0 +1,161 @@
+/**
+ *
+ * This file defines `DirRef`, a reference-counted handle to an open directory.
+ * Queue entries no longer hold full paths, instead they hold a reference to the
+ * directory they were found in together with their own name. Workers resolve
+ * entries relative to the parent's descriptor with `fstatat`/`openat`, so the
+ * kernel never walks the full path from the root again.
+ *
+ * Two counts are kept. `users` counts the entries that still need the descriptor
+ * and closes it when it drops to zero. `refs` keeps the structure itself alive for
+ * as long as a child `DirRef` may need its name to rebuild a path for an error
+ * message, or the full path is printed with the directory's total.
+ *
+ * A third count, `pending`, tracks the directory's unfinished work: one unit for
+ * listing the directory plus one for every child scheduled from it. Finished
+ * children add their size to `total`, and when `pending` reaches zero the
+ * subtree total is complete and is passed on to the parent the same way, so
+ * per-directory totals come out of the single parallel pass.
+ *
+ * The names of the entries scheduled from a directory are kept in its `names` 
+ * arena, which is freed together with the handle.
+ *
+ * With `--cache` a listed directory also points at the cache record collected for
+ * it, which receives the subtree total when the directory completes.
+ *
+ * With `--hints` the entries read below a directory are counted in `entries` the 
+ * same way as its blocks, and passed on to the parent once it completes.
+ *
+ * @file dirref.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Reference-counted directory handles for descriptor-relative traversal.
+ */
+
+#ifndef DIRREF_H
+#define DIRREF_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "slab.h"
+
+/**
+ * @note `dev` and `ino` identify the directory, they are filled in by the worker 
+ *       opening it. `entries` is only counted with `--hints`.
+ */
+typedef struct DirRef {
+    atomic_int refs;
+    atomic_int users;
+    atomic_int pending;
+    atomic_long total;
+    atomic_long entries;
+    dev_t dev;
+    ino_t ino;
+    int fd;
+    int depth;
+    struct DirRef* parent;
+    struct PendingRecord* record;
+    NameArena names;
+    char name[];
+} DirRef;
+
+/**
+ * @brief Creates a handle for a directory opened relative to `parent`.
+ *
+ * The handle starts with one user and one reference held by the caller and takes
+ * a reference on `parent`, which is kept until the handle is freed. One unit of 
+ * pending work is held for listing the directory.
+ *
+ * @param parent    The directory `name` was resolved in, `NULL` for a command line path.
+ * @param name      Name of the directory in `parent`, or the path as given.
+ * @param fd        Descriptor of the opened directory, closed with the last user.
+ *
+ * @return The new handle. Terminates the program if allocation fails.
+ */
+DirRef* create_dirref(DirRef* parent, const char* name, int fd);
+
+/**
+ * @brief Adds a user of the directory descriptor.
+ *
+ * Called for every entry scheduled with `dir` as its parent.
+ *
+ * @param dir The handle, may be `NULL`.
+ */
+void acquire_dirref(DirRef* dir);
+
+/**
+ * @brief Adds a unit of pending work to the directory.
+ *
+ * Called for every child scheduled from `dir` whose size is added later, each 
+ * unit is retired by one call to `dirref_child_done`.
+ *
+ * @param dir The handle.
+ */
+void dirref_expect(DirRef* dir);
+
+/**
+ * @brief Adds a finished child's size and retires one unit of pending work.
+ *
+ * @param dir   The handle.
+ * @param size  Size in blocks contributed by the child.
+ *
+ * @return true if this was the last unit, `dir->total` is then the final size of 
+ *         the subtree and the caller reports it to the parent.
+ */
+bool dirref_child_done(DirRef* dir, long size);
+
+/**
+ * @brief Drops a user of the directory descriptor.
+ *
+ * The descriptor is closed when the last user is gone, the handle itself is freed
+ * once no child handle references it either.
+ *
+ * @param dir The handle, may be `NULL`.
+ */
+void release_dirref(DirRef* dir);
+
+/**
+ * @brief Returns the descriptor entries of `dir` are resolved against.
+ *
+ * @param dir The handle, `NULL` resolves against the current working directory.
+ *
+ * @return The directory descriptor or `AT_FDCWD`.
+ */
+int dirref_fd(const DirRef* dir);
+
+/**
+ * @brief Rebuilds the full path of `name` inside `parent`.
+ *
+ * @param parent    The directory holding `name`, may be `NULL`.
+ * @param name      Name of the entry.
+ *
+ * @return A newly allocated path which the caller frees. Terminates the program
+ *         if allocation fails.
+ */
+char* build_path(const DirRef* parent, const char* name);
+
+/**
+ * @brief Returns the length of the full path of `name` inside `parent`.
+ *
+ * @param parent    The directory holding `name`, may be `NULL`.
+ * @param name      Name of the entry.
+ */
+size_t path_length(const DirRef* parent, const char* name);
+
+/**
+ * @brief Writes the full path of `name` inside `parent` without allocating.
+ *
+ * @param out       Receives the path, without a terminating null byte.
+ * @param len       Length of the path, from `path_length`.
+ * @param parent    The directory holding `name`, may be `NULL`.
+ * @param name      Name of the entry.
+ */
+void write_path(char* out, size_t len, const DirRef* parent, const char* name);
+
+#endif
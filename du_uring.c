@@ -0,0 +1,390 @@
+#include "du_uring.h"
+#define STATX_WANTED (STATX_TYPE | STATX_MODE | STATX_BLOCKS | STATX_INO | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE | STATX_MTIME | STATX_CTIME)
+
+bool uring_engine_available(void){
+    Uring ring;
+    if(uring_init(&ring, 8) < 0) return false;
+    bool available = uring_supports(&ring, IORING_OP_STATX);
+    uring_destroy(&ring);
+    return available;
+}
+
+static UringOp* create_op(UringWorker* w, UringOpKind kind, const char* name){
+    UringOp* op = slab_alloc(&w->ops);
+    op->next    = NULL;
+    op->kind    = kind;
+    op->entry   = NULL;
+    op->dir     = NULL;
+    op->fd      = -1;
+    op->name    = name;
+    return op;
+}
+
+static DirRef* op_parent(UringOp* op){
+    return op->entry != NULL ? op->entry->parent : op->dir;
+}
+
+static const char* op_name(UringOp* op){
+    return op->entry != NULL ? op->entry->name : op->name;
+}
+
+static void prepare(UringWorker* w, UringOp* op){
+    struct io_uring_sqe* sqe = uring_get_sqe(&w->ring);
+    if(sqe == NULL){
+        fprintf(stderr, "io_uring submission queue overflow, exiting.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    sqe->fd         = dirref_fd(op_parent(op));
+    sqe->addr       = (unsigned long)op_name(op);
+    sqe->user_data  = (unsigned long)op;
+    if(op->kind == OP_OPEN_DIR){
+        STATS_INC(w->args->stats->openat);
+        sqe->opcode     = IORING_OP_OPENAT;
+        sqe->open_flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+    } else {
+        STATS_INC(w->args->stats->statx);
+        sqe->opcode         = IORING_OP_STATX;
+        sqe->len            = STATX_WANTED;
+        sqe->off            = (unsigned long)&op->stx;
+        sqe->statx_flags    = AT_SYMLINK_NOFOLLOW;
+    }
+    w->inflight++;
+}
+
+static void flush_todo(UringWorker* w){
+    while(w->todo != NULL && w->inflight < URING_DEPTH){
+        UringOp* op = w->todo;
+        w->todo = op->next;
+        prepare(w, op);
+    }
+}
+
+void uring_enqueue(UringWorker* w, UringOp* op){
+    flush_todo(w);
+    if(w->inflight < URING_DEPTH && w->todo == NULL){
+        prepare(w, op);
+        return;
+    }
+    op->next = NULL;
+    if(w->todo == NULL) w->todo = op;
+    else w->todo_tail->next = op;
+    w->todo_tail = op;
+}
+
+static void retire_entry(UringWorker* w, UringOp* op){
+    destroy_entry(&w->args->entries, op->entry);
+    slab_free(&w->ops, op);
+    sched_done(w->args->sched, w->args->id);
+}
+
+static void fail_op(UringWorker* w, UringOp* op, const char* what, int res){
+    scan_error(w->args, what, op_parent(op), op_name(op), -res);
+}
+
+static bool op_first_link(UringWorker* w, UringOp* op){
+    struct statx* stx = &op->stx;
+    return first_link(w->args, makedev(stx->stx_dev_major, stx->stx_dev_minor), stx->stx_ino, stx->stx_nlink, stx->stx_mode);
+}
+
+static long op_size(UringWorker* w, UringOp* op){
+    return op_first_link(w, op) ? (long)op->stx.stx_blocks : 0;
+}
+
+static void account_op(UringWorker* w, UringOp* op, long size){
+    if(!w->args->account.enabled) return;
+    struct statx* stx = &op->stx;
+    account_entry(&w->args->account, op_name(op), stx->stx_mode, stx->stx_uid, stx->stx_gid, stx->stx_size,
+        stx->stx_mtime.tv_sec, size);
+}
+
+static bool other_device(UringWorker* w, UringOp* op){
+    if(!w->args->opts->one_file_system) return false;
+    dev_t dev = makedev(op->stx.stx_dev_major, op->stx.stx_dev_minor);
+    return dev != sched_device(w->args->sched, w->args->id);
+}
+
+static void complete_stat_entry(UringWorker* w, UringOp* op, int res){
+    if(res < 0) fail_op(w, op, "statx", res);
+    if(res < 0 || scan_cancelled(w->args)){
+        complete_child(w->args, op_parent(op), op->index_working_size, 0);
+        retire_entry(w, op);
+        return;
+    }
+
+    mode_t mode = op->stx.stx_mode;
+    //Entries listed without a type are matched as files once they are known to be one.
+    bool excluded = (S_ISREG(mode) || S_ISLNK(mode)) && op_parent(op) != NULL && entry_excluded(w->args, op_name(op), false);
+    if(excluded || (S_ISDIR(mode) && other_device(w, op))){
+        complete_child(w->args, op_parent(op), op->index_working_size, 0);
+        retire_entry(w, op);
+        return;
+    }
+
+    if(S_ISDIR(mode)){
+        op->size = op_size(w, op);
+        account_op(w, op, op->size);
+        op->kind = OP_OPEN_DIR;
+        if(w->async_open){
+            uring_enqueue(w, op);
+            return;
+        }
+
+        STATS_INC(w->args->stats->openat);
+        int fd = openat(dirref_fd(op_parent(op)), op_name(op), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        op->fd = fd == -1 ? -errno : fd;
+        op->next = w->ready;
+        w->ready = op;
+        return;
+    }
+
+    if(S_ISLNK(mode) || S_ISREG(mode)){
+        bool first = op_first_link(w, op);
+        long size = first ? (long)op->stx.stx_blocks : 0;
+        account_op(w, op, size);
+        if(first) report_entry(w->args, op_parent(op), op_name(op), size);
+        complete_child(w->args, op_parent(op), op->index_working_size, size);
+    } else if(S_ISCHR(mode) || S_ISBLK(mode) || S_ISFIFO(mode)){
+        complete_child(w->args, op_parent(op), op->index_working_size, 0);
+    } else {
+        scan_error(w->args, NULL, op_parent(op), op_name(op), 0);
+        complete_child(w->args, op_parent(op), op->index_working_size, 0);
+    }
+    retire_entry(w, op);
+}
+
+static void complete_open_dir(UringWorker* w, UringOp* op, int res){
+    op->fd = res;
+    op->next = w->ready;
+    w->ready = op;
+}
+
+static void complete_stat_child(UringWorker* w, UringOp* op, int res){
+    long size = 0;
+    if(res < 0) fail_op(w, op, "statx", res);
+    else {
+        bool first = op_first_link(w, op);
+        size = first ? (long)op->stx.stx_blocks : 0;
+        account_op(w, op, size);
+        if(first) report_entry(w->args, op->dir, op->name, size);
+    }
+    if(op->dir->record != NULL && res >= 0){
+        record_file(op->dir, makedev(op->stx.stx_dev_major, op->stx.stx_dev_minor), op->stx.stx_ino, op->stx.stx_nlink, op->stx.stx_blocks, size);
+    }
+    complete_child(w->args, op->dir, op->index_working_size, size);
+    release_dirref(op->dir);
+    slab_free(&w->ops, op);
+}
+
+void uring_reap(UringWorker* w, bool wait){
+    STATS_INC(w->args->stats->uring_enter);
+    STATS_CLOCK(start);
+    int ret = uring_submit(&w->ring, wait && w->inflight > 0 ? 1 : 0);
+    if(wait) STATS_SINCE(w->args->stats->ring_wait_ns, start);
+    if(ret < 0){
+        errno = -ret;
+        perror("io_uring_enter");
+        exit(EXIT_FAILURE);
+    }
+
+    struct io_uring_cqe* cqe;
+    while((cqe = uring_peek_cqe(&w->ring)) != NULL){
+        UringOp* op = (UringOp*)(unsigned long)cqe->user_data;
+        int res = cqe->res;
+        uring_cqe_seen(&w->ring);
+        w->inflight--;
+
+        switch (op->kind) {
+            case OP_STAT_ENTRY:
+                complete_stat_entry(w, op, res);
+                break;
+            case OP_OPEN_DIR:
+                complete_open_dir(w, op, res);
+                break;
+            case OP_STAT_CHILD:
+                complete_stat_child(w, op, res);
+                break;
+        }
+    }
+}
+
+static void statx_key(CacheKey* key, const struct statx* stx){
+    key->dev        = makedev(stx->stx_dev_major, stx->stx_dev_minor);
+    key->ino        = stx->stx_ino;
+    key->mtime_sec  = stx->stx_mtime.tv_sec;
+    key->mtime_nsec = stx->stx_mtime.tv_nsec;
+    key->ctime_sec  = stx->stx_ctime.tv_sec;
+    key->ctime_nsec = stx->stx_ctime.tv_nsec;
+}
+
+static bool list_cached_directory(UringWorker* w, UringOp* op, DirRef* dir){
+    WorkerArgs* args = w->args;
+    CacheKey key;
+    statx_key(&key, &op->stx);
+    dir->record = collector_begin(args->collector, &key);
+    const CacheRecord* rec = cache_lookup(args->cache, &key);
+    if(rec == NULL) return false;
+
+    op->size += replay_directory(dir, rec, args, op->index_working_size);
+    return true;
+}
+
+static void push_child(UringWorker* w, DirRef* dir, const char* name, ino_t ino, int index_working_size){
+    WorkerArgs* args = w->args;
+    if(dir->record != NULL) collector_add_name(args->collector, name);
+    dirref_expect(dir);
+    Entry* e = create_entry(&args->entries, dir, name, index_working_size);
+    if(ino != 0) hint_entry(args, e, dir, ino);
+    count_queued(args, e, 1);
+    sched_push(args->sched, args->id, e);
+}
+
+//Lists the rest of a directory, returns false if the listing was paused with `size` 
+//moved into the directory's total.
+static bool list_entries(UringWorker* w, DirRef* dir, int index_working_size, long size){
+    WorkerArgs* args = w->args;
+    LinuxDirent64* dp;
+    long n = 0;
+    long listed = 0;
+    dirreader_open(&args->reader, dir->fd);
+    errno = 0;
+    while(!scan_cancelled(args)){
+        if(listed > 0 && listing_paused(args)){
+            count_entries(args, dir, listed);
+            pause_directory(args, dir, index_working_size, size);
+            return false;
+        }
+        if((dp = dirreader_next(&args->reader)) == NULL) break;
+        UringOp* child;
+        STATS_INC(n);
+        listed++;
+        if(entry_excluded(args, dp->d_name, dp->d_type == DT_DIR || dp->d_type == DT_UNKNOWN)){
+            errno = 0;
+            continue;
+        }
+        switch (dp->d_type) {
+            case DT_REG:
+            case DT_LNK:
+                if(split_directory(args, listed)){
+                    push_child(w, dir, dp->d_name, 0, index_working_size);
+                    break;
+                }
+                STATS_INC(args->stats->files);
+                child = create_op(w, OP_STAT_CHILD, arena_strdup(&dir->names, dp->d_name));
+                child->dir = dir;
+                child->index_working_size = index_working_size;
+                acquire_dirref(dir);
+                dirref_expect(dir);
+                if(w->inflight >= URING_DEPTH) sched_flush(args->sched, args->id);
+                while(w->inflight >= URING_DEPTH) uring_reap(w, true);
+                uring_enqueue(w, child);
+                break;
+
+            //Ignore CHR,BLK,FIFO.
+            case DT_CHR:
+            case DT_BLK:
+            case DT_FIFO:
+                break;
+
+            default:
+                push_child(w, dir, dp->d_name, dp->d_ino, index_working_size);
+                break;
+        }
+        errno = 0;
+    }
+    if(errno != 0) scan_error(args, "getdents", dir->parent, dir->name, errno);
+    STATS_DIRECTORY(args->stats, dir, n);
+    count_entries(args, dir, listed);
+    sched_flush(args->sched, args->id);
+    if(dir->record != NULL) collector_end(args->collector, dir->record);
+    return true;
+}
+
+void uring_list_directory(UringWorker* w, UringOp* op){
+    WorkerArgs* args = w->args;
+    if(scan_cancelled(args)){
+        if(op->fd >= 0) close(op->fd);
+        retire_entry(w, op);
+        return;
+    }
+    if(op->fd < 0){
+        fail_op(w, op, "opendir", op->fd);
+        complete_child(args, op_parent(op), op->index_working_size, op->size);
+        retire_entry(w, op);
+        return;
+    }
+
+    DirRef* dir = create_dirref(op_parent(op), op_name(op), op->fd);
+    dir->dev = makedev(op->stx.stx_dev_major, op->stx.stx_dev_minor);
+    dir->ino = op->stx.stx_ino;
+    if(args->collector != NULL && list_cached_directory(w, op, dir)){
+        complete_child(args, dir, op->index_working_size, op->size);
+        release_dirref(dir);
+        retire_entry(w, op);
+        return;
+    }
+
+    if(list_entries(w, dir, op->index_working_size, op->size)) complete_child(args, dir, op->index_working_size, op->size);
+    release_dirref(dir);
+    retire_entry(w, op);
+}
+
+void* du_uring_thread(void* arg){
+    WorkerArgs* args = (WorkerArgs*)arg;
+    UringWorker w = { .args = args };
+
+    //Without a ring of its own the worker scans with the thread engine.
+    int err = uring_init(&w.ring, URING_DEPTH);
+    if(err < 0){
+        scan_error(args, "io_uring_setup", NULL, NULL, -err);
+        return du_worker_thread(args);
+    }
+    w.async_open = uring_supports(&w.ring, IORING_OP_OPENAT);
+    init_dirreader(&args->reader, DIRREAD_BUFFER_SIZE);
+    init_slab(&args->entries, sizeof(Entry));
+    init_slab(&w.ops, sizeof(UringOp));
+
+    while(1){
+        flush_todo(&w);
+        if(w.ready != NULL){
+            UringOp* op = w.ready;
+            w.ready = op->next;
+            uring_list_directory(&w, op);
+            continue;
+        }
+
+        while(w.inflight < URING_DEPTH && w.todo == NULL){
+            Entry* e = w.inflight == 0 ? sched_next(args->sched, args->id)
+                                       : sched_try_next(args->sched, args->id);
+            if(e == NULL) break;
+            count_queued(args, e, -1);
+            if(scan_cancelled(args)){
+                destroy_entry(&args->entries, e);
+                sched_done(args->sched, args->id);
+                continue;
+            }
+            if(e->name == NULL){
+                if(list_entries(&w, e->parent, e->index_working_size, 0)) complete_child(args, e->parent, e->index_working_size, 0);
+                destroy_entry(&args->entries, e);
+                sched_done(args->sched, args->id);
+                continue;
+            }
+
+            STATS_INC(args->stats->entries);
+            UringOp* op = create_op(&w, OP_STAT_ENTRY, NULL);
+            op->entry = e;
+            op->index_working_size = e->index_working_size;
+            uring_enqueue(&w, op);
+        }
+        if(w.inflight == 0 && w.todo == NULL && w.ready == NULL) break;
+
+        uring_reap(&w, true);
+    }
+
+    STATS_ADD(args->stats->getdents, args->reader.calls);
+    destroy_dirreader(&args->reader);
+    destroy_slab(&w.ops);
+    destroy_slab(&args->entries);
+    uring_destroy(&w.ring);
+    return NULL;
+}
@@ -0,0 +1,137 @@
+/**
+ * @file du_uring.c
+ * @brief Asynchronous io_uring engine for disk usage analysis.
+ *
+ * This file contains the alternative to `du_worker_thread` selected with
+ * `--engine=uring`. Instead of one blocking `lstat` per thread, every worker owns
+ * an io_uring ring and keeps up to `URING_DEPTH` `IORING_OP_STATX` requests in
+ * flight, so a few threads keep hundreds of metadata requests outstanding on
+ * high-latency storage. Directories are opened with `IORING_OP_OPENAT` where the
+ * kernel supports it, and listed synchronously through the worker's `DirReader`.
+ *
+ * Workers share the work-stealing scheduler with the thread engine: entries are
+ * taken with `sched_try_next` while requests are in flight and with the blocking
+ * `sched_next` only once the ring is empty. Subdirectories are pushed as entries,
+ * files found in a directory are sized by a statx request against the directory's
+ * descriptor without becoming entries.
+ *
+ * Completions never submit or list directly. A completed stat that needs a
+ * directory opened queues an open request, and an opened directory is put on a
+ * ready list which the worker's main loop lists. This keeps completion handling
+ * free of recursion so a listing can wait for ring space at any point.
+ *
+ * With `--cache` the sizes of a directory's files are added to its record as their
+ * statx requests complete, all on the worker that listed it.
+ *
+ * Errors and results go through the scan's callbacks as in the thread engine. Once 
+ * the scan is cancelled, requests in flight still complete but opened directories 
+ * are closed unlisted and new entries are retired untouched.
+ *
+ * @see du_worker.h for the thread engine and the shared worker arguments.
+ * @see uring.h for the ring itself.
+ *
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ */
+
+#ifndef DU_URING_H
+#define DU_URING_H
+
+#include "du_worker.h"
+#include "uring.h"
+#include <linux/stat.h>
+#include <sys/sysmacros.h>
+#include <stdbool.h>
+
+#define URING_DEPTH 256
+
+typedef enum {
+    OP_STAT_ENTRY,
+    OP_OPEN_DIR,
+    OP_STAT_CHILD,
+} UringOpKind;
+
+/**
+ * @note `entry` is set for requests made on behalf of a scheduled entry,
+ *       `dir` and `name` for files found while listing a directory. Such a name
+ *       lives in the arena of `dir`.
+ */
+typedef struct UringOp {
+    struct UringOp* next;
+    UringOpKind kind;
+    Entry* entry;
+    DirRef* dir;
+    int index_working_size;
+    int fd;
+    long size;
+    struct statx stx;
+    const char* name;
+} UringOp;
+
+typedef struct {
+    WorkerArgs* args;
+    Uring ring;
+    bool async_open;
+    unsigned int inflight;
+    UringOp* todo;
+    UringOp* todo_tail;
+    UringOp* ready;
+    Slab ops;
+} UringWorker;
+
+/**
+ * @brief Checks whether the uring engine can run on this kernel.
+ *
+ * Sets up a small ring and probes for `IORING_OP_STATX`. When this returns false
+ * the caller falls back to the thread engine.
+ *
+ * @return true if io_uring is usable and supports statx.
+ */
+bool uring_engine_available(void);
+
+/**
+ * @brief The main function executed by each uring engine worker.
+ *
+ * Takes entries from the scheduler and drives them through statx, openat and
+ * directory listing on the worker's ring until the scheduler reports that all
+ * work is done and no request is left in flight.
+ *
+ * @param arg A pointer to the worker's `WorkerArgs`.
+ *
+ * @return `NULL`, as `du_worker_thread`. A worker that cannot set up its ring 
+ *         reports the error and continues as `du_worker_thread`.
+ */
+void* du_uring_thread(void* arg);
+
+/**
+ * @brief Queues a request, submitting it right away if the ring has room.
+ *
+ * @param w     The calling worker.
+ * @param op    The request to submit.
+ */
+void uring_enqueue(UringWorker* w, UringOp* op);
+
+/**
+ * @brief Submits prepared requests and handles every available completion.
+ *
+ * @param w     The calling worker.
+ * @param wait  Whether to block until at least one completion arrives,
+ *              ignored when nothing is in flight.
+ */
+void uring_reap(UringWorker* w, bool wait);
+
+/**
+ * @brief Lists an opened directory, pushing subdirectories and sizing files.
+ *
+ * Regular files and symbolic links get a statx request each, subdirectories and
+ * `DT_UNKNOWN` entries are scheduled as entries. Waits for completions whenever
+ * the ring is full.
+ *
+ * @param w     The calling worker.
+ * @param op    The open request that produced the descriptor, its entry is
+ *              retired and the directory's listing unit completed once listing 
+ *              is done.
+ */
+void uring_list_directory(UringWorker* w, UringOp* op);
+
+#endif
@@ -1,81 +1,140 @@
 #include "du_worker.h"
-void* du_worker_thread(void* arg){
-    WorkerArgs* args = (WorkerArgs*)arg;
-    int finished = 0;
-    char* path = NULL;
-    int* status = (int*)malloc(sizeof(int));
-    *status = EXIT_SUCCESS;
-    while(1){
-
-        //Assume thread is going to wait.
-        atomic_fetch_add(args->active_threads,-1);
-        if (is_queue_empty(args->queued_entries) && *args -> active_threads == 0) {
-            finished = 1;
-            for(int i = 0; i < args->nthreads; i++) sem_post(args->sem_queue);
+static void account_stat(WorkerArgs* args, const char* name, const struct stat* st, long size){
+    if(!args->account.enabled) return;
+    account_entry(&args->account, name, st->st_mode, st->st_uid, st->st_gid, st->st_size, st->st_mtime, size);
+}
+
+//`ino` is the inode listed for a directory or an entry of unknown type, 0 for a file.
+static void push_child(WorkerArgs* args, DirRef* dir, const char* name, ino_t ino, int index_working_size){
+    if(args->collector != NULL) collector_add_name(args->collector, name);
+    dirref_expect(dir);
+    Entry* e = create_entry(&args->entries, dir, name, index_working_size);
+    if(ino != 0) hint_entry(args, e, dir, ino);
+    count_queued(args, e, 1);
+    sched_push(args->sched, args->id, e);
+}
+
+//Lists the rest of a directory, adding the blocks of the files it sizes to `*size`. 
+//Returns false if the listing was paused.
+static bool list_directory(DirRef* dir, WorkerArgs* args, int index_working_size, long* size){
+    LinuxDirent64 *dp;
+    long n = 0;
+    long listed = 0;
+    dirreader_open(&args->reader, dir->fd);
+    errno = 0;
+    while(!scan_cancelled(args)){
+        //Only between two reads, and never before this listing made progress.
+        if(listed > 0 && listing_paused(args)){
+            count_entries(args, dir, listed);
+            pause_directory(args, dir, index_working_size, *size);
+            return false;
+        }
+        if((dp = dirreader_next(&args->reader)) == NULL) break;
+        STATS_INC(n);
+        listed++;
+        if(entry_excluded(args, dp->d_name, dp->d_type == DT_DIR || dp->d_type == DT_UNKNOWN)){
+            errno = 0;
+            continue;
         }
+        switch (dp->d_type) {
+            case DT_REG:
+            case DT_LNK:
+                if(split_directory(args, listed)) push_child(args, dir, dp->d_name, 0, index_working_size);
+                else *size += handle_file(args, dir, dp->d_name);
+                break;
 
-        sem_wait(args->sem_queue);
-        
-        if(finished){
-            free(path);
-            pthread_exit((void*)status);
-        } 
+            //Ignore CHR,BLK,FIFO.
+            case DT_CHR:
+            case DT_BLK:
+            case DT_FIFO:
+                break;
+
+            //Directories, and anything the file system did not classify, go through open_resource.
+            default:
+                push_child(args, dir, dp->d_name, dp->d_ino, index_working_size);
+                break;
+        }
+        errno = 0;
+    }
+    if(errno != 0) scan_error(args, "getdents", dir->parent, dir->name, errno);
+    STATS_DIRECTORY(args->stats, dir, n);
+    count_entries(args, dir, listed);
+    sched_flush(args->sched, args->id);
+    return true;
+}
 
-        //Set thread as active.
-        atomic_fetch_add(args->active_threads,+1);
+static void resume_directory(WorkerArgs* args, DirRef* dir, int index_working_size){
+    long size = 0;
+    if(list_directory(dir, args, index_working_size, &size)) complete_child(args, dir, index_working_size, size);
+}
 
-        //If the queue is empty, wait
-        int index_working_size = 0;
-        if(path != NULL) free(path);
-        if((path = pop_q(args->queued_entries, &index_working_size)) == NULL){
+void* du_worker_thread(void* arg){
+    WorkerArgs* args = (WorkerArgs*)arg;
+    Entry* e;
+    init_dirreader(&args->reader, DIRREAD_BUFFER_SIZE);
+    init_slab(&args->entries, sizeof(Entry));
+    while((e = sched_next(args->sched, args->id)) != NULL){
+        count_queued(args, e, -1);
+        if(scan_cancelled(args)){
+            destroy_entry(&args->entries, e);
+            sched_done(args->sched, args->id);
             continue;
-        } 
+        }
+        if(e->name == NULL){
+            resume_directory(args, e->parent, e->index_working_size);
+            destroy_entry(&args->entries, e);
+            sched_done(args->sched, args->id);
+            continue;
+        }
 
-        Resource r = open_resource(path);
-        if(r.type == TYPE_UNKNOWN){
-            fprintf(stderr,"resource at %s was of an unexpected type, exiting.\n", path);
-            exit(EXIT_FAILURE);
-        } 
+        DirRef* parent = e->parent;
+        char* name = e->name;
+        int index_working_size = e->index_working_size;
 
-        int size;
-        DIR* dir; 
+        dev_t dev;
+        if(args->opts->one_file_system) dev = sched_device(args->sched, args->id);
+        Resource r = open_resource(parent, name, args->opts->one_file_system ? &dev : NULL);
+        STATS_INC(args->stats->entries);
+        STATS_INC(args->stats->lstat);
+        if(r.type == TYPE_DIR || r.type == DENIED_DIR) STATS_INC(args->stats->openat);
+        //Entries listed without a type are matched as files once they are known to be one.
+        if(parent != NULL && (r.type == TYPE_FILE || r.type == TYPE_LNK) && entry_excluded(args, name, false)) r.type = TYPE_IGNORE;
+
+        bool first = first_link(args, r.stat.st_dev, r.stat.st_ino, r.stat.st_nlink, r.stat.st_mode);
+        long size = first ? getSize(r.stat) : 0;
+        DirRef* dir; 
         switch (r.type) {
             case TYPE_DIR:
-                dir = (DIR*) r.resource;
-                size = handle_directory(dir, path, args->queued_entries, args->sem_queue, index_working_size);
-                closedir(dir);
-                atomic_fetch_add(&(args -> results[index_working_size]), size);
+                dir = (DirRef*) r.resource;
+                account_stat(args, name, &r.stat, size);
+                if(handle_directory(dir, &r.stat, args, index_working_size, &size)) complete_child(args, dir, index_working_size, size);
+                release_dirref(dir);
                 break;
             
+            //The entry still counts with whatever could be sized.
             case DENIED_DIR:
-                fprintf(stderr, "du: cannot read directory '%s': Permission denied\n", path);
-                size = handle_file(path);
-                atomic_fetch_add(&(args -> results[index_working_size]), size);
-                (*status) = EXIT_FAILURE;
+            case TYPE_ERROR:
+                if(r.type == DENIED_DIR || strcmp(r.op, "lstat") != 0) account_stat(args, name, &r.stat, size);
+                scan_error(args, r.op, parent, name, r.error);
+                complete_child(args, parent, index_working_size, size);
                 break;
 
-
-            case TYPE_FILE:
-                size = handle_file(path);                
-                atomic_fetch_add(&(args -> results[index_working_size]), size);
+            case TYPE_UNKNOWN:
+                scan_error(args, NULL, parent, name, 0);
+                complete_child(args, parent, index_working_size, 0);
                 break;
 
+            case TYPE_FILE:
             case DENIED_FILE:
-                size = handle_file(path);
-                atomic_fetch_add(&(args -> results[index_working_size]), size);
-                break;
-
             case TYPE_LNK:
-                size = handle_file(path);
-                atomic_fetch_add(&(args -> results[index_working_size]), size);
-                break;
-
             case DENIED_LNK:
-                size = handle_file(path);
-                atomic_fetch_add(&(args -> results[index_working_size]), size);
+                account_stat(args, name, &r.stat, size);
+                if(first) report_entry(args, parent, name, size);
+                complete_child(args, parent, index_working_size, size);
                 break;
 
             case TYPE_IGNORE:
+                complete_child(args, parent, index_working_size, 0);
                 break;
 
             default:
@@ -83,96 +142,211 @@ void* du_worker_thread(void* arg){
                 exit(EXIT_FAILURE);
                 break;
         }
+
+        destroy_entry(&args->entries, e);
+        sched_done(args->sched, args->id);
     }
-    free(args);
-    return NULL; //Todo competent return
+    STATS_ADD(args->stats->getdents, args->reader.calls);
+    destroy_dirreader(&args->reader);
+    destroy_slab(&args->entries);
+    return NULL;
 }
 
-int handle_directory(DIR* dir, char* base_path, Queue* q, sem_t* sem_queue, int index_working_size){
-    if (dir == NULL) return 0;
-    struct dirent *dp;
 
-    while((dp = readdir(dir)) != NULL){
-        //skip '.','..'
-        if (strcmp(dp->d_name, ".") == 0 || strcmp(dp->d_name, "..") == 0){
-            continue;
-        } 
+long replay_directory(DirRef* dir, const CacheRecord* rec, WorkerArgs* args, int index_working_size){
+    const char* name = cache_names(args->cache, rec);
+    for(uint32_t i = 0; i < rec->nnames; i++){
+        collector_add_name(args->collector, name);
+        dirref_expect(dir);
+        sched_push(args->sched, args->id, create_entry(&args->entries, dir, name, index_working_size));
+        name += strlen(name) + 1;
+    }
+    sched_flush(args->sched, args->id);
+    dir->record->rec.own_blocks = rec->own_blocks;
+    collector_end(args->collector, dir->record);
 
-        char full_path[pathconf("/", _PC_PATH_MAX)];
-        snprintf(full_path, sizeof(full_path), "%s/%s", base_path, dp->d_name);
+    long size = rec->own_blocks;
+    const CacheLink* links = cache_links(args->cache, rec);
+    for(uint32_t i = 0; i < rec->nlinks; i++){
+        collector_add_link(dir->record, links[i].dev, links[i].ino, links[i].blocks);
+        if(args->inodes == NULL || inoset_insert(args->inodes, links[i].dev, links[i].ino)) size += links[i].blocks;
+    }
+    return size;
+}
+
+void record_file(DirRef* dir, dev_t dev, ino_t ino, nlink_t nlink, long blocks, long size){
+    if(nlink > 1) collector_add_link(dir->record, dev, ino, blocks);
+    else dir->record->rec.own_blocks += size;
+}
 
-        push_q(q, full_path, sem_queue, index_working_size);
+bool handle_directory(DirRef* dir, const struct stat* st, WorkerArgs* args, int index_working_size, long* size){
+    if (dir == NULL) return true;
+    if(args->collector != NULL){
+        CacheKey key;
+        cache_key_from_stat(&key, st);
+        dir->record = collector_begin(args->collector, &key);
+        const CacheRecord* rec = cache_lookup(args->cache, &key);
+        if(rec != NULL){
+            *size += replay_directory(dir, rec, args, index_working_size);
+            return true;
+        }
     }
 
-    int dir_size;
-    struct stat stat;
-    if(lstat(base_path, &stat) == -1){
-        perror("lstat");
-        exit(EXIT_FAILURE);
+    if(!list_directory(dir, args, index_working_size, size)) return false;
+    if(dir->record != NULL) collector_end(args->collector, dir->record);
+    return true;
+}
+
+void pause_directory(WorkerArgs* args, DirRef* dir, int index_working_size, long size){
+    if(size != 0) atomic_fetch_add_explicit(&dir->total, size, memory_order_relaxed);
+    sched_flush(args->sched, args->id);
+    sched_defer(args->sched, args->id, create_resume_entry(&args->entries, dir, index_working_size));
+}
+
+//Passes the entries below a completed directory on to its parent, which cannot 
+//complete before this worker retires the directory's unit of it.
+static void record_hint(WorkerArgs* args, DirRef* dir){
+    long entries = atomic_load_explicit(&dir->entries, memory_order_relaxed);
+    if(entries >= HINT_MIN_ENTRIES) hint_add(args->hint_collector, dir->dev, dir->ino, entries);
+    if(dir->parent != NULL) atomic_fetch_add_explicit(&dir->parent->entries, entries, memory_order_relaxed);
+}
+
+void complete_child(WorkerArgs* args, DirRef* parent, int index_working_size, long size){
+    while(parent != NULL){
+        if(!dirref_child_done(parent, size)) return;
+
+        size = atomic_load_explicit(&parent->total, memory_order_relaxed);
+        if(parent->record != NULL) parent->record->rec.total = size;
+        if(args->hint_collector != NULL) record_hint(args, parent);
+        report_directory(args, parent, size);
+        parent = parent->parent;
     }
-    dir_size = getSize(stat);
-    return dir_size;
+    atomic_fetch_add(&(args -> results[index_working_size]), size);
+}
+
+void report_directory(WorkerArgs* args, DirRef* dir, long total){
+    const ScanCallbacks* cb = &args->scan->callbacks;
+    if(scan_cancelled(args)) return;
+    if(dir->depth > 0 && top_wants(&args->top_dirs, total)) top_insert(&args->top_dirs, total, build_path(dir->parent, dir->name));
+    if(cb->directory == NULL || dir->depth > args->opts->max_depth) return;
+    cb->directory(cb->user, dir, total);
+}
+
+void report_entry(WorkerArgs* args, const DirRef* parent, const char* name, long size){
+    const ScanCallbacks* cb = &args->scan->callbacks;
+    if(scan_cancelled(args)) return;
+    if(top_wants(&args->top_files, size)) top_insert(&args->top_files, size, build_path(parent, name));
+    if(cb->entry == NULL) return;
+    cb->entry(cb->user, parent, name, size);
 }
 
-int handle_file(char* path){
+bool is_denied_directory(const ScanError* err){
+    return err->op != NULL && strcmp(err->op, "opendir") == 0 && err->error == EACCES;
+}
+
+bool scan_error(WorkerArgs* args, const char* op, const DirRef* parent, const char* name, int error){
+    ScanState* scan = args->scan;
+    ScanError err = { .op = op, .parent = parent, .name = name, .error = error };
+    bool resume = scan->callbacks.error != NULL ? scan->callbacks.error(scan->callbacks.user, &err)
+                                                : is_denied_directory(&err);
+    if(resume){
+        int expected = SCAN_OK;
+        atomic_compare_exchange_strong(&scan->status, &expected, SCAN_PARTIAL);
+    } else {
+        atomic_store(&scan->status, SCAN_FAILED);
+        atomic_store(&scan->cancelled, true);
+    }
+    return resume;
+}
+
+int handle_file(WorkerArgs* args, DirRef* parent, const char* name){
     struct stat stat;
-    if(lstat(path, &stat) == -1){
-        perror("lstat");
-        exit(EXIT_FAILURE);
+    STATS_INC(args->stats->files);
+    STATS_INC(args->stats->lstat);
+    if(fstatat(dirref_fd(parent), name, &stat, AT_SYMLINK_NOFOLLOW) == -1){
+        scan_error(args, "lstat", parent, name, errno);
+        return 0;
     }
-    return getSize(stat);
+    bool first = first_link(args, stat.st_dev, stat.st_ino, stat.st_nlink, stat.st_mode);
+    long size = first ? getSize(stat) : 0;
+    if(parent != NULL && parent->record != NULL) record_file(parent, stat.st_dev, stat.st_ino, stat.st_nlink, getSize(stat), size);
+    account_stat(args, name, &stat, size);
+    //As du -a, a further link to a counted file is not listed.
+    if(first) report_entry(args, parent, name, size);
+    return size;
 }
 
-Resource open_resource(const char* path){
-    struct stat path_stat;
+Resource open_resource(DirRef* parent, const char* name, const dev_t* dev){
     Resource r;
-    int permission = access(path, R_OK) == 0;     
+    int parent_fd = dirref_fd(parent);
     r.resource  = NULL;
     r.type      = TYPE_UNKNOWN;
+    r.op        = NULL;
+    r.error     = 0;
+    memset(&r.stat, 0, sizeof(r.stat));
     
-    if(lstat(path, &path_stat) == -1){
-        perror("lstat");
-        exit(EXIT_FAILURE);
+    if(fstatat(parent_fd, name, &r.stat, AT_SYMLINK_NOFOLLOW) == -1){
+        r.type  = TYPE_ERROR;
+        r.op    = "lstat";
+        r.error = errno;
+        return r;
     }
     
-    else if(S_ISLNK(path_stat.st_mode)){
-        setType(permission, &r, TYPE_LNK);
+    else if(S_ISLNK(r.stat.st_mode)){
+        setType(1, &r, TYPE_LNK);
         return r;
     }
     
-    else if(S_ISDIR(path_stat.st_mode)){
-        if(!permission){
-            setType(permission, &r, TYPE_DIR);
+    else if(S_ISDIR(r.stat.st_mode) && dev != NULL && r.stat.st_dev != *dev){
+        setType(1, &r, TYPE_IGNORE);
+        return r;
+    }
+
+    else if(S_ISDIR(r.stat.st_mode)){
+        int fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if(fd == -1){
+            r.op    = "opendir";
+            r.error = errno;
+            if(errno == EACCES) setType(0, &r, TYPE_DIR);
+            else r.type = TYPE_ERROR;
             return r;
-        }else{
-            r.resource = opendir(path);
-            if(r.resource == NULL){
-                perror("opendir");
-                exit(EXIT_FAILURE);
-            } 
-            else {
-                setType(permission, &r, TYPE_DIR);
-                return r;
-            }
-        } 
+        }
+        DirRef* dir = create_dirref(parent, name, fd);
+        dir->dev    = r.stat.st_dev;
+        dir->ino    = r.stat.st_ino;
+        r.resource  = dir;
+        setType(1, &r, TYPE_DIR);
+        return r;
     }
     
-    else if(S_ISREG(path_stat.st_mode)){
-        setType(permission, &r, TYPE_FILE);
+    else if(S_ISREG(r.stat.st_mode)){
+        setType(1, &r, TYPE_FILE);
         return r;
     }
 
     //Ignore CHR,BLK,FIFO.
 
-    else if(S_ISCHR(path_stat.st_mode)  || S_ISBLK(path_stat.st_mode) ||
-            S_ISFIFO(path_stat.st_mode)){
-        setType(permission, &r, TYPE_IGNORE);
+    else if(S_ISCHR(r.stat.st_mode)  || S_ISBLK(r.stat.st_mode) ||
+            S_ISFIFO(r.stat.st_mode)){
+        setType(1, &r, TYPE_IGNORE);
         return r;
     }
 
     return r;
 }
 
+void perror_at(const char* op, const DirRef* parent, const char* name){
+    int err = errno;
+    char* path = build_path(parent, name);
+    fprintf(stderr, "%s: %s: %s\n", op, path, strerror(err));
+    free(path);
+    errno = err;
+}
+
+bool first_link(WorkerArgs* args, dev_t dev, ino_t ino, nlink_t nlink, mode_t mode){
+    return nlink <= 1 || args->inodes == NULL || S_ISDIR(mode) || inoset_insert(args->inodes, dev, ino);
+}
+
 inline void setType(int permission, Resource* r, ResourceType t){
     if(permission) r->type = t;
     else r->type = t | PERMISSION_DENIED; 
@@ -180,4 +354,4 @@ inline void setType(int permission, Resource* r, ResourceType t){
 
 inline int getSize(struct stat path_stat){
     return path_stat.st_blocks;
-}
\ No newline at end of file
+}
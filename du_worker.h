@@ -4,15 +4,65 @@
  *
  * This file contains the implementation of worker threads responsible 
  * for analyzing disk usage by processing directories and files. 
- * Each thread reads from a shared queue of paths, determines the type 
+ * Each thread takes entries from the work-stealing scheduler, determines the type 
  * of each path (file, directory, symlink, etc.), and computes the size 
- * of the resources. Results are stored in an array for each thread, 
- * and proper synchronization is ensured using semaphores and atomic 
- * variables.
+ * of the resources. Entries found in a directory are pushed onto the worker's 
+ * own deque, idle workers steal from the others. Results are accumulated in an 
+ * array of atomic counters, one for each path given on the command line.
+ *
+ * Entries are resolved relative to the descriptor of the directory they were 
+ * found in (`fstatat`/`openat`), full paths are only rebuilt for error messages. 
+ * Directories are listed through the worker's own `DirReader`, entries come from 
+ * the worker's slab and their names from the listed directory's arena, see slab.h. 
+ * Files with more 
+ * than one hard link are only counted for the first link found, tracked by the 
+ * shared `InodeSet` unless `--count-links` was given.
+ *
+ * Sizes are added to the total of the directory holding the entry. Once all of a 
+ * directory's entries are accounted for its total is printed, if within 
+ * `--max-depth`, and added to its parent, see dirref.h. The total of a command 
+ * line path ends up in the results array.
+ *
+ * With `-x` directories on another device than the command line path they were 
+ * found below are skipped before they are opened, as with `du -x`. Entries dropped 
+ * by `--exclude` are skipped as soon as they are listed, before they are sized or 
+ * queued, see filter.h.
+ *
+ * Files are sized by the worker listing their directory, other entries are pushed 
+ * to the scheduler. With `--split-dirs=N` the files after the first N entries of a 
+ * directory are pushed as well, batch by batch as they are read, so the workers 
+ * idle while one of them lists a huge flat directory stat its files meanwhile.
+ *
+ * Workers take the entries they pushed last first, so a worker goes depth first 
+ * through the subtree it is listing and the scheduled entries are mostly those of 
+ * the directories on its current path. With `--max-queue-mem` a listing also 
+ * pauses between two reads of its directory once the scheduled entries take more 
+ * than the given number of bytes. The directory is scheduled again behind all 
+ * other work with its descriptor, and thereby its position, kept open, and 
+ * whichever worker takes it lists on from there. Memory then follows the depth and 
+ * fanout of the directories being listed instead of the number of entries found.
+ *
+ * With `--cache` every listed directory is recorded in the worker's collector, and 
+ * a directory found unchanged in the previous scan's cache is not listed at all, 
+ * see cache.h.
+ *
+ * Each worker counts its system calls, the entries it processed and the largest 
+ * directory it listed in its `WorkerStats` when built with `MDU_STATS`, see stats.h. 
+ * With `--top` it also keeps its own heaps of the largest files and directories, 
+ * see top.h, and with `--group-by` or `--histogram` its own accounting of every 
+ * sized entry, see account.h.
+ *
+ * Results leave the workers through the scan's `ScanCallbacks` while the scan 
+ * runs: every sized file or link, every completed directory within `--max-depth` 
+ * and every error. An error either skips the entry, which then contributes what 
+ * could be sized, or cancels the scan. A cancelled scan is drained: workers keep 
+ * taking entries and retire them without looking at them, so every descriptor is 
+ * closed and every handle freed by the time the workers return.
  *
  * @note The processing of each resource type is handled within the worker thread, 
  *       including error handling for permission issues and unknown resource types.
  *
+ * @see scheduler.h for the scheduler handing out entries.
  * @see queue.h for queue management functions.
  * 
  * @author Melker Henriksson
@@ -23,6 +73,16 @@
 #define DU_WORKER_H
 
 #include "queue.h"
+#include "scheduler.h"
+#include "dirread.h"
+#include "inoset.h"
+#include "cache.h"
+#include "top.h"
+#include "account.h"
+#include "filter.h"
+#include "writer.h"
+#include "topology.h"
+#include "hints.h"
 #include <stdio.h>
 #include <dirent.h>
 #include <stdlib.h>
@@ -35,6 +95,9 @@
 #include <semaphore.h>
 #include <signal.h>
 #include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdbool.h>
 
 typedef enum {
     NOT_RUNNING,
@@ -43,14 +106,142 @@ typedef enum {
 
 typedef struct extended_Thread extended_Thread;
 
+typedef enum {
+    ENGINE_THREAD,
+    ENGINE_URING,
+} Engine;
+
+/**
+ * @note `max_depth` is the deepest level of directories printed with their own 
+ *       total, 0 only prints the command line paths.
+ * @note `cache_path` is `NULL` unless `--cache` was given, `daemon_socket` is 
+ *       `NULL` unless `--daemon` was given.
+ * @note `hints_path` is `NULL` unless `--hints` was given, see hints.h.
+ * @note `stats` is set by `--stats`, the counters are printed by `worker_join`.
+ * @note `device_threads` is the most workers scanning one device at once, 0 for no 
+ *       limit, `one_file_system` is set by `-x`.
+ * @note `auto_threads` is set by `-j auto`, `nthreads` is then the cap of the 
+ *       controller, see tuner.h.
+ * @note `top` is the number of largest files and directories kept by `--top`, 
+ *       0 for none.
+ * @note `group_by` is set by `--group-by`, `size_histogram` and `age_histogram` 
+ *       by `--histogram`, see account.h.
+ * @note `filter` holds the `--exclude` and `--include` rules, `NULL` for none, 
+ *       it is not copied and has to outlive the scans, see filter.h.
+ * @note `split_dirs` is the number of entries set by `--split-dirs` after which 
+ *       the files of a directory are scheduled instead of sized by the worker 
+ *       listing it, 0 to always size them there.
+ * @note `format` is the output format set by `--format` and `all` is set by `-a`, 
+ *       both are only used by the `mdu` command, see writer.h.
+ * @note `max_queue_mem` is the number of bytes of scheduled entries set by 
+ *       `--max-queue-mem` above which directory listings pause, 0 for no limit. * @note `topology` places the workers on the CPUs and nodes given by `--cpus` and 
+ *       `--numa`, `NULL` to leave them to the kernel. As `filter` it is not copied, 
+ *       see topology.h.
+ */
+typedef struct {
+    int nthreads;
+    bool auto_threads;
+    Engine engine;
+    bool count_links;
+    bool one_file_system;
+    int device_threads;
+    int max_depth;
+    const char* cache_path;
+    const char* daemon_socket;
+    const char* hints_path;
+    bool stats;
+    int top;
+    GroupKey group_by;
+    bool size_histogram;
+    bool age_histogram;
+    Filter* filter;
+    long split_dirs;
+    OutputFormat format;
+    bool all;
+    long max_queue_mem;
+    Topology* topology;
+} Options;
+
+/**
+ * @note `op` names the failed call, `lstat`, `statx`, `opendir`, `getdents` or 
+ *       `io_uring_setup`, or is `NULL` for an entry of an unexpected type.
+ * @note `parent` and `name` locate the entry as for `build_path`, `name` is 
+ *       `NULL` for an error that concerns no entry.
+ * @note `error` is the `errno` of the failed call, 0 when `op` is `NULL`.
+ */
+typedef struct {
+    const char* op;
+    const DirRef* parent;
+    const char* name;
+    int error;
+} ScanError;
+
+/**
+ * @note Every callback may be `NULL` and is called on the worker threads, 
+ *       concurrently, with `user` as its first argument.
+ * @note `entry` is called for every file and link with its size in blocks, not for 
+ *       a further link to a counted inode. Every directory is listed while it is 
+ *       set, the previous cache is not read, see `mdu_scan`.
+ * @note `directory` is called with the subtree total of every completed directory 
+ *       at most `max_depth` levels below a command line path, including the 
+ *       command line paths themselves at depth 0.
+ * @note `error` returns true to skip the entry and continue, false to cancel the 
+ *       scan. Without it the scan continues past directories it may not read and 
+ *       stops at any other error.
+ */
+typedef struct {
+    void (*entry)(void* user, const DirRef* parent, const char* name, long blocks);
+    void (*directory)(void* user, const DirRef* dir, long total);
+    bool (*error)(void* user, const ScanError* err);
+    void* user;
+} ScanCallbacks;
+
+/**
+ * @note `SCAN_PARTIAL` means some entries were skipped after an error.
+ */
+typedef enum {
+    SCAN_OK,
+    SCAN_PARTIAL,
+    SCAN_CANCELLED,
+    SCAN_FAILED,
+} ScanStatus;
+
+/**
+ * @note Shared by all workers of one scan. `status` holds `SCAN_OK`, 
+ *       `SCAN_PARTIAL` or `SCAN_FAILED`, a cancelled scan is told by `cancelled`.
+ */
+typedef struct {
+    ScanCallbacks callbacks;
+    atomic_bool cancelled;
+    atomic_int status;
+} ScanState;
+
+/**
+ * @note `hints` are the subtree sizes read from `--hints` and `hint_collector` 
+ *       receives those of this scan, both are `NULL` without `--hints`.
+ * @note `matcher` matches names against `opts->filter` with regular expressions 
+ *       compiled for this worker alone, see filter.h.
+ */
 typedef struct {
     atomic_long* results;
-    atomic_short* active_threads;
-    sem_t* sem_queue;
-    Queue* queued_entries;
+    const Options* opts;
+    ScanState* scan;
+    Scheduler* sched;
+    InodeSet* inodes;
+    const ScanCache* cache;
+    CacheCollector* collector;
+    const Hints* hints;
+    Hints* hint_collector;
+    WorkerStats* stats;
+    TopHeap top_files;
+    TopHeap top_dirs;
+    Accounting account;
+    FilterMatcher matcher;
     extended_Thread* self;
+    int id;
     int nthreads;
-    pthread_mutex_t* shared_mutex;
+    DirReader reader;
+    Slab entries;
 } WorkerArgs;
 
 struct extended_Thread {
@@ -68,106 +259,351 @@ typedef enum {
     TYPE_LNK                = 1 << 3,
     TYPE_IGNORE             = 1 << 4,
     TYPE_UNKNOWN            = 1 << 5,
+    TYPE_ERROR              = 1 << 6,
 
     DENIED_FILE             = TYPE_FILE | PERMISSION_DENIED,
     DENIED_DIR              = TYPE_DIR  | PERMISSION_DENIED,
     DENIED_LNK              = TYPE_LNK  | PERMISSION_DENIED, 
 } ResourceType;
 
+/**
+ * @note `op` and `error` name the failed call and its `errno` for `TYPE_ERROR` 
+ *       and denied directories.
+ */
 typedef struct {
     void* resource;
     ResourceType type;
+    struct stat stat;
+    const char* op;
+    int error;
 } Resource;
 
+/**
+ * @brief Returns whether the scan was cancelled.
+ *
+ * @param args The calling worker's arguments.
+ */
+static inline bool scan_cancelled(const WorkerArgs* args){
+    return atomic_load_explicit(&args->scan->cancelled, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns whether the files of a directory are scheduled once `listed` 
+ *        entries of it have been read.
+ *
+ * @param args      Pointer to the worker's arguments.
+ * @param listed    Number of entries of the directory read so far.
+ *
+ * @note Directories are never split while a cache is recorded. A cached directory 
+ *       replays the blocks of its files without their inodes, so a file linked 
+ *       from a split directory would be counted again when replayed.
+ */
+static inline bool split_directory(const WorkerArgs* args, long listed){
+    return args->opts->split_dirs > 0 && listed > args->opts->split_dirs && args->nthreads > 1 && args->collector == NULL;
+}
+
+/**
+ * @brief Counts the memory of an entry scheduled or taken by the worker.
+ *
+ * Only entries found in a directory are counted, command line paths and resumed 
+ * listings are not.
+ *
+ * @param args  Pointer to the worker's arguments.
+ * @param e     The entry.
+ * @param sign  1 for an entry scheduled, -1 for one taken.
+ */
+static inline void count_queued(WorkerArgs* args, const Entry* e, long sign){
+    if(args->opts->max_queue_mem == 0 || e->parent == NULL || e->name == NULL) return;
+    sched_count_bytes(args->sched, args->id, sign * (long)(sizeof(Entry) + strlen(e->name) + 1));
+}
+
+/**
+ * @brief Sets the hint of an entry scheduled from a directory, see hints.h.
+ *
+ * @param args  Pointer to the worker's arguments.
+ * @param e     The entry.
+ * @param dir   The directory the entry was listed in.
+ * @param ino   Inode of the entry as listed.
+ */
+static inline void hint_entry(WorkerArgs* args, Entry* e, const DirRef* dir, ino_t ino){
+    if(args->hints == NULL || args->hints->n == 0) return;
+    long entries = hint_lookup(args->hints, dir->dev, ino);
+    e->hint = entries > INT_MAX ? INT_MAX : entries;
+}
+
+/**
+ * @brief Counts the entries read while listing a directory for `--hints`.
+ *
+ * @param args      Pointer to the worker's arguments.
+ * @param dir       The directory.
+ * @param listed    Number of entries read.
+ */
+static inline void count_entries(WorkerArgs* args, DirRef* dir, long listed){
+    if(args->hint_collector != NULL) atomic_fetch_add_explicit(&dir->entries, listed, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns whether the listing of a directory pauses before reading on.
+ *
+ * A listing pauses once the reader returned every entry it read and the entries 
+ * waiting in the scheduler hold more than `--max-queue-mem` bytes.
+ *
+ * @param args  Pointer to the worker's arguments.
+ *
+ * @note Listings never pause while a cache is recorded, the collector records one 
+ *       directory at a time.
+ */
+static inline bool listing_paused(WorkerArgs* args){
+    return args->opts->max_queue_mem > 0 && args->collector == NULL && dirreader_drained(&args->reader) 
+        && sched_queued_bytes(args->sched) > args->opts->max_queue_mem;
+}
+
+/**
+ * @brief Returns whether an entry found while listing a directory is dropped by 
+ *        the `--exclude` and `--include` rules.
+ *
+ * @param args  Pointer to the worker's arguments.
+ * @param name  Name of the entry.
+ * @param dir   Whether the entry may be a directory, see `filter_excludes`.
+ */
+static inline bool entry_excluded(const WorkerArgs* args, const char* name, bool dir){
+    return args->opts->filter != NULL && filter_excludes(&args->matcher, name, dir);
+}
+
 /**
  * @brief The main function executed by each worker thread for disk usage analysis.
  *
- * This function retrieves file paths from a shared queue and processes each path 
+ * This function retrieves file paths from the scheduler and processes each path 
  * to calculate disk usage. It handles different resource types, including files, 
  * directories, and symlinks, and updates the results accordingly. 
- * Each thread operates in a loop, waiting for paths to become available in the 
- * queue, and it synchronizes access to shared resources using semaphores and 
- * atomic variables.
+ * Each thread operates in a loop until the scheduler reports that every entry 
+ * has been processed.
  *
  * The function will:
- * - Wait for work to be available by using a semaphore.
+ * - Ask the scheduler for the next entry, sleeping while no work is available.
  * - Process each path by determining its type and calling the appropriate handling 
  *   function (e.g., `handle_file`, `handle_directory`).
- * - Manage the state of active threads and update the results based on the processed 
- *   paths.
+ * - Retire the entry with `sched_done` once its children have been scheduled.
+ *
+ * Once the scan is cancelled entries are retired without being processed.
  *
  * @param arg A pointer to a `WorkerArgs` structure containing the worker's 
- *            arguments, including the shared queue, results array, 
- *            and synchronization primitives.
+ *            arguments, including the scheduler and results array.
+ *
+ * @return `NULL`, errors are recorded in the scan's `ScanState`.
  */
 void* du_worker_thread(void* args);
 
 /**
- * @brief Opens a resource at the specified path and determines its type.
+ * @brief Accounts a finished child of `parent` and completes finished directories.
+ *
+ * Adds `size` to `parent` and retires one unit of its pending work. Every 
+ * directory completed this way is reported with `report_directory` and its total 
+ * passed on to its own parent, up to the command line path whose total is added 
+ * to `results[index_working_size]`.
+ *
+ * @param args The calling worker's arguments.
+ * @param parent The directory the child belongs to, `NULL` for a command line path.
+ * @param index_working_size Index of the result the child contributes to.
+ * @param size Size of the child in blocks.
+ */
+void complete_child(WorkerArgs* args, DirRef* parent, int index_working_size, long size);
+
+/**
+ * @brief Passes the total of a completed directory to the `directory` callback.
+ *
+ * Directories below the command line paths are offered to the worker's heap of 
+ * the largest directories. Directories deeper than `--max-depth` are not passed 
+ * to the callback, and nothing is once the scan is cancelled.
+ *
+ * @param args The calling worker's arguments.
+ * @param dir The completed directory.
+ * @param total Size of the directory's subtree in blocks.
+ */
+void report_directory(WorkerArgs* args, DirRef* dir, long total);
+
+/**
+ * @brief Passes a sized file or link to the `entry` callback.
+ *
+ * The entry is also offered to the worker's heap of the largest files.
+ *
+ * @param args   The calling worker's arguments.
+ * @param parent The directory holding the entry, `NULL` for a command line path.
+ * @param name   Name of the entry.
+ * @param size   Size of the entry in blocks.
+ */
+void report_entry(WorkerArgs* args, const DirRef* parent, const char* name, long size);
+
+/**
+ * @brief Reports an error to the `error` callback and records it in the scan.
+ *
+ * A skipped entry marks the scan `SCAN_PARTIAL`, otherwise the scan is marked 
+ * `SCAN_FAILED` and cancelled.
+ *
+ * @param args   The calling worker's arguments.
+ * @param op     Name of the failed call, `NULL` for an entry of unexpected type.
+ * @param parent The directory holding the entry, may be `NULL`.
+ * @param name   Name of the entry, `NULL` if the error concerns no entry.
+ * @param error  The `errno` of the failed call.
+ *
+ * @return true if the scan continues.
+ */
+bool scan_error(WorkerArgs* args, const char* op, const DirRef* parent, const char* name, int error);
+
+/**
+ * @brief Returns whether an error is a directory that may not be read.
+ *
+ * These are skipped by scans without an `error` callback, as `du` does.
+ *
+ * @param err The error.
+ */
+bool is_denied_directory(const ScanError* err);
+
+/**
+ * @brief Opens a resource and determines its type.
  *
- * This function checks the file system object at the given path, retrieves its 
- * status information, and categorizes it into one of several resource types: 
- * regular file, directory, symbolic link, or ignored types (character device, 
- * block device, FIFO). It also checks for read permissions on the resource.
+ * This function checks the file system object `name` inside the directory `parent`, 
+ * retrieves its status information, and categorizes it into one of several resource 
+ * types: regular file, directory, symbolic link, or ignored types (character device, 
+ * block device, FIFO). Directories are opened relative to the parent's descriptor, 
+ * a directory that cannot be opened due to missing permissions is marked as denied. 
+ * A directory on another device than `*dev` is not opened and marked as ignored. 
+ * Any other failure is marked `TYPE_ERROR`, with the failed call and its `errno`.
  *
  * The function performs the following operations:
- * - Retrieves the status of the resource using `lstat`.
- * - Determines resource type and permission.
+ * - Retrieves the status of the resource using `fstatat`.
+ * - Determines resource type and opens directories with `openat`.
  * - The function updates the `Resource` structure with the appropriate 
  *   type and resource pointer.
  *
- * @param path A pointer to a null-terminated string representing the 
- *             path to the resource to be opened.
+ * @param parent The directory holding the resource, `NULL` for a command line path.
+ * @param name A pointer to a null-terminated string holding the name of the 
+ *             resource in `parent`.
+ * @param dev The device directories must be on, `NULL` for any device.
  *
  * @return A `Resource` structure containing:
- *         - `resource`: A pointer to the opened directory or a path.
+ *         - `resource`: A `DirRef` for an opened directory, otherwise `NULL`.
+ *         - `stat`: The status retrieved by `fstatat`, reused for the size.
  *         - `type`: The determined type of the resource (e.g., 
  *           `TYPE_FILE`, `TYPE_DIR`, `TYPE_LNK`, or `TYPE_IGNORE`).
  *         The type will also indicate if permission was denied 
  *         using the least significant bit.
  */
-Resource open_resource(const char* path);
+Resource open_resource(DirRef* parent, const char* name, const dev_t* dev);
 
 /**
- * @brief Processes a directory and queues its contents for further handling.
+ * @brief Processes a directory, accounting for its files and queueing the rest.
  *
- * This function takes a directory stream and iterates through its entries. For 
- * each entry that is not `.` or `..`, it constructs the full path and adds it 
- * to a queue for processing by worker threads. It also retrieves the size of the 
- * directory based on the provided base path.
+ * This function iterates through the entries of an opened directory and uses the 
+ * `d_type` reported by `getdents64` to avoid a queue round trip for plain entries. 
+ * Regular files and symbolic links are sized right away with a single `fstatat` 
+ * against the directory's descriptor, devices and FIFOs are skipped. Only 
+ * subdirectories, and entries whose type is `DT_UNKNOWN` on file systems that do 
+ * not fill in `d_type`, are scheduled for `open_resource`.
+ *
+ * When the worker collects a cache the directory gets a record of its own entries. 
+ * If the directory is unchanged since the previous scan it is not read, the size of 
+ * its own entries comes from the cache and only the recorded names are scheduled.
  *
  * The function performs the following operations:
- * - Checks if the directory stream is valid.
- * - Retrieves the status of the base path using `lstat` to determine its size.
- * - Iterates through the directory entries using `readdir`.
- * - Constructs the full path for each entry and adds it to the queue via `push_q`.
- *
- * @param dir A pointer to the directory stream to be processed.
- * @param base_path A pointer to a null-terminated string representing the 
- *                  base path of the directory being processed.
- * @param q A pointer to the `Queue` structure where the entries will be queued.
- * @param sem_queue A pointer to a semaphore used to synchronize access to the queue.
+ * - Checks if the directory handle is valid.
+ * - Iterates through the directory entries using the worker's `DirReader`, until 
+ *   the scan is cancelled.
+ * - Sizes files and links in place using `handle_file`.
+ * - Schedules every other entry via `sched_push`, adding pending work to `dir`.
+ * - Pauses the listing with `pause_directory` once `listing_paused` says so.
+ *
+ * A failure to read the directory is reported with `scan_error`, the entries read 
+ * until then are kept.
+ *
+ * @param dir A pointer to the handle of the directory to be processed.
+ * @param st The status of the directory, used as its cache key.
+ * @param args The calling worker's arguments, providing the reader and the deque 
+ *             receiving the entries.
  * @param index_working_size An integer representing the index associated with 
  *                           the current working size for the entries being queued.
+ * @param size Blocks of the directory itself on entry, the blocks of the entries 
+ *             sized in place are added to it.
+ *
+ * @return True once the directory is listed, or if the directory handle is NULL, 
+ *         `size` then still has to be passed to `complete_child`. False if the 
+ *         listing was paused, `size` then went into the directory's total.
+ */
+bool handle_directory(DirRef* dir, const struct stat* st, WorkerArgs* args, int index_working_size, long* size);
+
+/**
+ * @brief Replays the cache record of an unchanged directory instead of listing it.
+ *
+ * The recorded names are scheduled and copied to the directory's new record, as 
+ * are its links. Every link is entered in the inode set as if the file had been 
+ * stated, so a file also linked from a relisted directory is counted once.
  *
- * @return The size of the directory in blocks as obtained from the `lstat` call.
- *         Returns 0 if the directory stream is NULL.
+ * @param dir                   The directory, holding its new record.
+ * @param rec                   The directory's record in the previous cache.
+ * @param args                  Pointer to the worker's arguments.
+ * @param index_working_size    Index of the result the directory contributes to.
+ *
+ * @return The blocks of the directory's own files, to be added to its size.
+ */
+long replay_directory(DirRef* dir, const CacheRecord* rec, WorkerArgs* args, int index_working_size);
+
+/**
+ * @brief Adds a file sized while listing a directory to the directory's record.
+ *
+ * A file with several hard links is added as a link with all of its blocks, any 
+ * other file adds `size` to `own_blocks`, see cache.h.
+ *
+ * @param dir       The directory holding the file, with a record.
+ * @param dev       Device of the file.
+ * @param ino       Inode of the file.
+ * @param nlink     Number of hard links to the file.
+ * @param blocks    Size of the file in blocks.
+ * @param size      Blocks counted for the file, 0 unless `first_link`.
  */
-int handle_directory(DIR* dir, char* path, Queue* q, sem_t* sem_queue, int index_working_size);
+void record_file(DirRef* dir, dev_t dev, ino_t ino, nlink_t nlink, long blocks, long size);
+
+/**
+ * @brief Pauses the listing of a directory, see `listing_paused`.
+ *
+ * The batch of entries scheduled so far is flushed and the listing is scheduled 
+ * again with `sched_defer`. The directory stays pending until the listing is 
+ * resumed and completed.
+ *
+ * @param args                  Pointer to the worker's arguments.
+ * @param dir                   The directory being listed.
+ * @param index_working_size    Index of the result the directory contributes to.
+ * @param size                  Blocks sized while listing so far, added to the 
+ *                              directory's total.
+ */
+void pause_directory(WorkerArgs* args, DirRef* dir, int index_working_size, long size);
 
 /**
  * @brief Retrieves the size of a file.
  *
- * This function takes the path to a file, retrieves its status using `lstat`,
- * and returns the size of the file in blocks.
+ * This function retrieves the status of `name` inside `parent` using `fstatat`
+ * and returns the size of the file in blocks if `first_link` counts it. 
+ * The file is passed to `report_entry`, a failure to `scan_error`.
  *
- * @param path A pointer to a null-terminated string representing the path 
- *             to the file whose size is to be determined.
+ * @param args The calling worker's arguments, providing the inode set.
+ * @param parent The directory holding the file, `NULL` for a command line path.
+ * @param name A pointer to a null-terminated string holding the name of the file.
  *
- * @return The size of the file in blocks as retrieved from the `getSize` function.
- * 
+ * @return The size of the file in blocks, 0 for a further link to a counted inode 
+ *         or a file that could not be sized.
  */
-int handle_file(char* path);
+int handle_file(WorkerArgs* args, DirRef* parent, const char* name);
+
+/**
+ * @brief Prints an error for an operation on `name` inside `parent`.
+ *
+ * Rebuilds the full path of the resource and prints it together with `op` and 
+ * the description of the current `errno`, which is preserved.
+ *
+ * @param op        Name of the failed operation.
+ * @param parent    The directory holding the resource, may be `NULL`.
+ * @param name      Name of the resource.
+ */
+void perror_at(const char* op, const DirRef* parent, const char* name);
 
 /**
  * @brief Retrieves the size of a file or directory in blocks.
@@ -182,6 +618,25 @@ int handle_file(char* path);
  */
 int getSize(struct stat path_stat);
 
+/**
+ * @brief Returns whether a resource is counted, entering it in the inode set.
+ *
+ * Non-directories with `st_nlink > 1` are looked up in the worker's inode set, 
+ * every link after the first one found is not counted and contributes no blocks. 
+ * Without an inode set, when `--count-links` was given, every resource is counted. 
+ * Files are only passed to `report_entry` when counted, so that `-a` lists a file 
+ * with several hard links once, as `du -a` does.
+ *
+ * @param args The calling worker's arguments, providing the inode set.
+ * @param dev Device of the resource.
+ * @param ino Inode number of the resource.
+ * @param nlink Number of hard links to the resource.
+ * @param mode File type and mode of the resource.
+ *
+ * @return false for a further link to a file already counted.
+ */
+bool first_link(WorkerArgs* args, dev_t dev, ino_t ino, nlink_t nlink, mode_t mode);
+
 /**
  * @brief Sets the type of a resource based on its permissions.
  *
@@ -0,0 +1,150 @@
+#include "filter.h"
+Filter* create_filter(void){
+    Filter* f = calloc(1, sizeof(Filter));
+    if(f == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    f->include_only = true;
+    return f;
+}
+
+void destroy_filter(Filter* f){
+    if(f == NULL) return;
+    for(int i = 0; i < f->n; i++) free(f->rules[i].pattern);
+    free(f->rules);
+    free(f);
+}
+
+static char* copy(const char* s, size_t len){
+    char* c = strndup(s, len);
+    if(c == NULL){
+        perror("strndup");
+        exit(EXIT_FAILURE);
+    }
+    return c;
+}
+
+//Splits a glob into the cheapest test that decides it, see filter.h.
+static void compile_glob(FilterRule* rule){
+    const char* p = rule->pattern;
+    const char* tail = p;
+    int wildcards = 0;
+    for(const char* c = p; *c != '\0'; c++){
+        if(strchr("*?[]\\", *c) == NULL) continue;
+        wildcards++;
+        tail = c + 1;
+    }
+
+    rule->literal       = (char*)tail;
+    rule->literal_len   = strlen(tail);
+    if(wildcards == 0) rule->kind = MATCH_NAME;
+    else if(wildcards == 1 && p[0] == '*') rule->kind = MATCH_SUFFIX;
+    else rule->kind = MATCH_GLOB;
+}
+
+static int compile_regex(regex_t* regex, const char* pattern){
+    //A rule matches the whole name, as a glob does.
+    char anchored[strlen(pattern) + 5];
+    snprintf(anchored, sizeof(anchored), "^(%s)$", pattern);
+    return regcomp(regex, anchored, REG_EXTENDED | REG_NOSUB);
+}
+
+int filter_add(Filter* f, FilterSyntax syntax, bool include, const char* pattern){
+    FilterRule rule = { .include = include, .literal = NULL, .literal_len = 0 };
+    if(syntax == FILTER_REGEX){
+        //Only checked here, every matcher compiles its own copy.
+        regex_t regex;
+        int err = compile_regex(&regex, pattern);
+        if(err != 0) return err;
+        regfree(&regex);
+        rule.kind       = MATCH_REGEX;
+        rule.pattern    = copy(pattern, strlen(pattern));
+    } else {
+        rule.pattern    = copy(pattern, strlen(pattern));
+        compile_glob(&rule);
+    }
+
+    if(f->n == f->cap){
+        f->cap = f->cap == 0 ? 4 : f->cap * 2;
+        FilterRule* rules = realloc(f->rules, f->cap * sizeof(FilterRule));
+        if(rules == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        f->rules = rules;
+    }
+    f->rules[f->n++] = rule;
+    f->include_only &= include;
+
+    if(rule.literal_len == 0){
+        f->any_last = true;
+    } else {
+        unsigned char c = rule.literal[rule.literal_len - 1];
+        f->last[c >> 6] |= 1ULL << (c & 63);
+    }
+    return 0;
+}
+
+void init_matcher(FilterMatcher* m, const Filter* f){
+    m->filter   = f;
+    m->regex    = NULL;
+    if(f == NULL || f->n == 0) return;
+
+    m->regex = malloc(f->n * sizeof(regex_t));
+    if(m->regex == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < f->n; i++){
+        if(f->rules[i].kind != MATCH_REGEX) continue;
+        if(compile_regex(&m->regex[i], f->rules[i].pattern) != 0){
+            fprintf(stderr, "regcomp: cannot compile %s\n", f->rules[i].pattern);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void destroy_matcher(FilterMatcher* m){
+    if(m->regex != NULL){
+        for(int i = 0; i < m->filter->n; i++){
+            if(m->filter->rules[i].kind == MATCH_REGEX) regfree(&m->regex[i]);
+        }
+    }
+    free(m->regex);
+    m->regex = NULL;
+}
+
+static bool ends_with(const char* name, size_t len, const FilterRule* rule){
+    return len >= rule->literal_len && memcmp(name + len - rule->literal_len, rule->literal, rule->literal_len) == 0;
+}
+
+static bool rule_matches(const FilterRule* rule, const regex_t* regex, const char* name, size_t len){
+    switch (rule->kind) {
+        case MATCH_NAME:
+            return len == rule->literal_len && memcmp(name, rule->literal, len) == 0;
+        case MATCH_SUFFIX:
+            return ends_with(name, len, rule);
+        case MATCH_GLOB:
+            return ends_with(name, len, rule) && fnmatch(rule->pattern, name, 0) == 0;
+        case MATCH_REGEX:
+            return regexec(regex, name, 0, NULL, 0) == 0;
+    }
+    return false;
+}
+
+bool filter_excludes(const FilterMatcher* m, const char* name, bool dir){
+    const Filter* f = m->filter;
+    //Without exclude rules only what is included is kept, see filter.h.
+    bool unmatched = f->include_only && f->n > 0 && !dir;
+    size_t len = strlen(name);
+    if(!f->any_last){
+        unsigned char c = len == 0 ? 0 : name[len - 1];
+        if(!(f->last[c >> 6] >> (c & 63) & 1)) return unmatched;
+    }
+
+    for(int i = 0; i < f->n; i++){
+        if(rule_matches(&f->rules[i], &m->regex[i], name, len)) return !f->rules[i].include;
+    }
+    return unmatched;
+}
@@ -0,0 +1,147 @@
+/**
+ *
+ * This file defines the matcher behind `--exclude` and `--include`. The rules are
+ * compiled once, before the scan, and every name found while listing a directory
+ * is matched against them before it is sized or queued, so an excluded subtree is
+ * never opened, listed or scheduled.
+ *
+ * Rules match the name of an entry, not its path. Glob rules follow fnmatch(3),
+ * regex rules are POSIX extended expressions that have to match the whole name.
+ * Rules are tried in the order they were added and the first one matching decides,
+ * an include rule keeps the entry, an exclude rule drops it together with
+ * everything below it. A name no rule matches is kept, unless every rule is an
+ * include rule: the entry is then dropped, except for a directory, which is still
+ * listed so that the names included below it are found. The paths the scan starts
+ * from are never matched.
+ *
+ * Most names match no rule, so the matcher is built to reject them cheaply. A glob
+ * without wildcards is compared as a literal name and a glob of the form `*lit` as
+ * a literal suffix, neither calls fnmatch. Other globs keep the literal tail after
+ * their last wildcard, fnmatch is only called for names ending in it. When every
+ * rule ends in a literal character the last characters they may end in are kept
+ * in a bitmap, and a name ending in any other character is kept without trying
+ * a single rule.
+ *
+ * Workers match through a `FilterMatcher` of their own, holding their own copy of
+ * every compiled regular expression. regexec(3) takes a lock inside the compiled
+ * expression in glibc, so workers sharing one would take turns on every name.
+ *
+ * @file filter.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Exclude and include rules matched against entry names.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fnmatch.h>
+#include <regex.h>
+
+typedef enum {
+    FILTER_GLOB,
+    FILTER_REGEX,
+} FilterSyntax;
+
+typedef enum {
+    MATCH_NAME,
+    MATCH_SUFFIX,
+    MATCH_GLOB,
+    MATCH_REGEX,
+} MatchKind;
+
+/**
+ * @note `literal` is the whole name for `MATCH_NAME`, the suffix for
+ *       `MATCH_SUFFIX` and the literal tail names have to end in for
+ *       `MATCH_GLOB`, empty if the glob ends in a wildcard.
+ */
+typedef struct {
+    MatchKind kind;
+    bool include;
+    char* pattern;
+    char* literal;
+    size_t literal_len;
+} FilterRule;
+
+/**
+ * @note `last` has bit `c` set if a rule may match a name ending in `c`, it is
+ *       only consulted while `any_last` is false.
+ * @note `include_only` is true while every rule is an include rule.
+ */
+typedef struct {
+    FilterRule* rules;
+    int n;
+    int cap;
+    bool include_only;
+    bool any_last;
+    uint64_t last[4];
+} Filter;
+
+/**
+ * @note `regex` holds a compiled expression for every rule, only those of
+ *       `MATCH_REGEX` rules are used.
+ */
+typedef struct {
+    const Filter* filter;
+    regex_t* regex;
+} FilterMatcher;
+
+/**
+ * @brief Creates a filter without rules.
+ *
+ * @return The filter, freed with `destroy_filter`.
+ */
+Filter* create_filter(void);
+
+/**
+ * @brief Frees a filter and its compiled rules.
+ *
+ * @param f Pointer to the filter, may be `NULL`.
+ */
+void destroy_filter(Filter* f);
+
+/**
+ * @brief Compiles a rule and appends it to the filter.
+ *
+ * @param f         Pointer to the filter.
+ * @param syntax    Whether `pattern` is a glob or a regular expression.
+ * @param include   True for an include rule, false for an exclude rule.
+ * @param pattern   The pattern, copied.
+ *
+ * @return 0 on success, the regcomp(3) error of an invalid regular expression
+ *         otherwise, the filter is then left unchanged.
+ */
+int filter_add(Filter* f, FilterSyntax syntax, bool include, const char* pattern);
+
+/**
+ * @brief Prepares a worker's matcher for a filter.
+ *
+ * @param m Pointer to the matcher.
+ * @param f Pointer to the filter, `NULL` for a matcher that keeps every name. It
+ *          has to outlive the matcher and get no further rules.
+ */
+void init_matcher(FilterMatcher* m, const Filter* f);
+
+/**
+ * @brief Frees the regular expressions of a matcher.
+ *
+ * @param m Pointer to the matcher.
+ */
+void destroy_matcher(FilterMatcher* m);
+
+/**
+ * @brief Returns whether an entry is dropped by the filter.
+ *
+ * @param m     Pointer to the calling worker's matcher, of a filter.
+ * @param name  Name of the entry.
+ * @param dir   Whether the entry may be a directory, which no rule matching keeps 
+ *              even when every rule is an include rule.
+ */
+bool filter_excludes(const FilterMatcher* m, const char* name, bool dir);
+
+#endif
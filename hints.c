@@ -0,0 +1,131 @@
+#include "hints.h"
+void init_hints(Hints* h){
+    h->records  = NULL;
+    h->n        = 0;
+    h->cap      = 0;
+}
+
+void destroy_hints(Hints* h){
+    free(h->records);
+    init_hints(h);
+}
+
+static int compare_record(const void* a, const void* b){
+    const HintRecord* x = a;
+    const HintRecord* y = b;
+    if(x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+    if(x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+    return 0;
+}
+
+static bool read_all(int fd, void* buffer, size_t size){
+    char* p = buffer;
+    while(size > 0){
+        ssize_t n = read(fd, p, size);
+        if(n == -1 && errno == EINTR) continue;
+        if(n <= 0) return false;
+        p       += n;
+        size    -= n;
+    }
+    return true;
+}
+
+void read_hints(Hints* h, const char* path){
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd == -1){
+        if(errno != ENOENT) perror(path);
+        return;
+    }
+
+    HintsHeader header;
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 && read_all(fd, &header, sizeof(header))
+        && memcmp(header.magic, HINTS_MAGIC, sizeof(header.magic)) == 0
+        && header.version == HINTS_VERSION && header.record_size == sizeof(HintRecord)
+        && header.nrecords == (st.st_size - sizeof(header)) / sizeof(HintRecord);
+    if(valid && header.nrecords > 0){
+        h->records = malloc(header.nrecords * sizeof(HintRecord));
+        if(h->records == NULL){
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        h->n = h->cap = header.nrecords;
+        valid = read_all(fd, h->records, h->n * sizeof(HintRecord));
+    }
+    close(fd);
+
+    if(!valid){
+        fprintf(stderr, "mdu: ignoring invalid hints %s\n", path);
+        destroy_hints(h);
+    }
+}
+
+long hint_lookup(const Hints* h, uint64_t dev, uint64_t ino){
+    if(h->n == 0) return 0;
+    HintRecord key = { .dev = dev, .ino = ino, .entries = 0 };
+    const HintRecord* r = bsearch(&key, h->records, h->n, sizeof(HintRecord), compare_record);
+    return r == NULL ? 0 : r->entries;
+}
+
+void hint_add(Hints* h, uint64_t dev, uint64_t ino, long entries){
+    if(h->n == h->cap){
+        h->cap = h->cap == 0 ? 64 : h->cap * 2;
+        HintRecord* records = realloc(h->records, h->cap * sizeof(HintRecord));
+        if(records == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        h->records = records;
+    }
+    h->records[h->n++] = (HintRecord){ .dev = dev, .ino = ino, .entries = entries };
+}
+
+int write_hints(const char* path, Hints h[], int n){
+    size_t count = 0;
+    for(int i = 0; i < n; i++) count += h[i].n;
+
+    size_t size = sizeof(HintsHeader) + count * sizeof(HintRecord);
+    HintsHeader* header = calloc(1, size);
+    if(header == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(header->magic, HINTS_MAGIC, sizeof(header->magic));
+    header->version     = HINTS_VERSION;
+    header->record_size = sizeof(HintRecord);
+    header->nrecords    = count;
+
+    HintRecord* records = (HintRecord*)(header + 1);
+    size_t at = 0;
+    for(int i = 0; i < n; i++){
+        if(h[i].n == 0) continue;
+        memcpy(records + at, h[i].records, h[i].n * sizeof(HintRecord));
+        at += h[i].n;
+    }
+    qsort(records, count, sizeof(HintRecord), compare_record);
+
+    size_t len = strlen(path);
+    char* tmp = malloc(len + sizeof(".tmp"));
+    if(tmp == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", sizeof(".tmp"));
+
+    int ret = -1;
+    FILE* f = fopen(tmp, "wb");
+    if(f != NULL){
+        ret = fwrite(header, size, 1, f) == 1 ? 0 : -1;
+        if(fclose(f) != 0) ret = -1;
+        if(ret == 0) ret = rename(tmp, path);
+        if(ret != 0){
+            int err = errno;
+            unlink(tmp);
+            errno = err;
+        }
+    }
+    free(tmp);
+    free(header);
+    return ret;
+}
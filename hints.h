@@ -0,0 +1,126 @@
+/**
+ *
+ * This file defines the subtree size hints kept with `--hints=FILE`. A scan counts
+ * the entries read below every directory and records each directory holding at
+ * least `HINT_MIN_ENTRIES` of them, keyed by its device and inode. The next scan
+ * with the same FILE looks up every directory it schedules by the inode listed in
+ * its parent, and schedules those expected to be expensive ahead of all other
+ * work, see scheduler.h. Their subtrees are then split over the workers from the
+ * start instead of being found late and walked by whichever worker is left.
+ *
+ * Only large subtrees are recorded, so the file stays small and a lookup is a
+ * binary search over a few records. A hint is only an estimate, a missing, stale
+ * or unrelated file changes the order entries are scanned in, never the result.
+ *
+ * File layout, native byte order:
+ *   HintsHeader
+ *   HintRecord[nrecords], sorted by (dev, ino)
+ *
+ * The file is read completely before the scan and replaced atomically with
+ * `rename` after it, as the cache is, see cache.h.
+ *
+ * @file hints.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Subtree sizes of a previous scan used to schedule large subtrees first.
+ */
+
+#ifndef HINTS_H
+#define HINTS_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#define HINTS_MAGIC "MDUHINTS"
+#define HINTS_VERSION 1
+#define HINT_MIN_ENTRIES 1024
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t nrecords;
+} HintsHeader;
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+    int64_t entries;
+} HintRecord;
+
+/**
+ * @note Used both for the hints read before a scan, sorted, and for the records
+ *       a worker collects during one, in the order the directories completed.
+ */
+typedef struct {
+    HintRecord* records;
+    size_t n;
+    size_t cap;
+} Hints;
+
+/**
+ * @brief Initializes an empty set of hints.
+ *
+ * @param h Pointer to the hints.
+ */
+void init_hints(Hints* h);
+
+/**
+ * @brief Frees the records of a set of hints.
+ *
+ * @param h Pointer to the hints.
+ */
+void destroy_hints(Hints* h);
+
+/**
+ * @brief Reads the hints written by a previous scan.
+ *
+ * A missing file leaves the hints empty. An unreadable or invalid file is
+ * reported on stderr and leaves them empty as well.
+ *
+ * @param h     Pointer to empty hints.
+ * @param path  Path of the hints file.
+ */
+void read_hints(Hints* h, const char* path);
+
+/**
+ * @brief Returns the entries recorded below a directory.
+ *
+ * @param h     Pointer to hints read with `read_hints`.
+ * @param dev   Device of the directory.
+ * @param ino   Inode of the directory.
+ *
+ * @return The number of entries, 0 if the directory was not recorded.
+ */
+long hint_lookup(const Hints* h, uint64_t dev, uint64_t ino);
+
+/**
+ * @brief Records the entries below a completed directory.
+ *
+ * @param h         Pointer to the calling worker's hints.
+ * @param dev       Device of the directory.
+ * @param ino       Inode of the directory.
+ * @param entries   Entries read below the directory.
+ */
+void hint_add(Hints* h, uint64_t dev, uint64_t ino, long entries);
+
+/**
+ * @brief Writes the hints collected by the workers of a scan.
+ *
+ * @param path  Path of the hints file.
+ * @param h     The hints of every worker.
+ * @param n     Number of workers.
+ *
+ * @return 0 on success, -1 with `errno` set on failure. The previous file is
+ *         left intact on failure.
+ */
+int write_hints(const char* path, Hints h[], int n);
+
+#endif
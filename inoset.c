@@ -0,0 +1,82 @@
+#include "inoset.h"
+//Inode 0 is never handed out by Linux file systems, so it marks an empty slot.
+#define EMPTY_INO 0
+
+static uint64_t hash_key(uint64_t dev, uint64_t ino){
+    //splitmix64 finalizer over both halves of the key.
+    uint64_t x = ino ^ (dev * 0x9e3779b97f4a7c15ULL);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+InodeSet* create_inoset(void){
+    InodeSet* set = malloc(sizeof(InodeSet));
+    if(set == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < INOSET_SHARDS; i++){
+        pthread_mutex_init(&set->shards[i].lock, NULL);
+        set->shards[i].count    = 0;
+        set->shards[i].capacity = 0;
+        set->shards[i].slots    = NULL;
+    }
+    return set;
+}
+
+void destroy_inoset(InodeSet* set){
+    if(set == NULL) return;
+    for(int i = 0; i < INOSET_SHARDS; i++){
+        pthread_mutex_destroy(&set->shards[i].lock);
+        free(set->shards[i].slots);
+    }
+    free(set);
+}
+
+static InodeKey* find_slot(InodeKey* slots, size_t capacity, uint64_t hash, uint64_t dev, uint64_t ino){
+    size_t i = hash & (capacity - 1);
+    while(slots[i].ino != EMPTY_INO && (slots[i].ino != ino || slots[i].dev != dev)){
+        i = (i + 1) & (capacity - 1);
+    }
+    return &slots[i];
+}
+
+static void grow_shard(InodeShard* shard){
+    size_t capacity = shard->capacity == 0 ? INOSET_INITIAL_CAPACITY : shard->capacity * 2;
+    InodeKey* slots = calloc(capacity, sizeof(InodeKey));
+    if(slots == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    for(size_t i = 0; i < shard->capacity; i++){
+        InodeKey k = shard->slots[i];
+        if(k.ino == EMPTY_INO) continue;
+        *find_slot(slots, capacity, hash_key(k.dev, k.ino) >> INOSET_SHARD_BITS, k.dev, k.ino) = k;
+    }
+    free(shard->slots);
+    shard->slots    = slots;
+    shard->capacity = capacity;
+}
+
+bool inoset_insert(InodeSet* set, dev_t dev, ino_t ino){
+    uint64_t hash = hash_key(dev, ino);
+    InodeShard* shard = &set->shards[hash & (INOSET_SHARDS - 1)];
+    hash >>= INOSET_SHARD_BITS;
+
+    pthread_mutex_lock(&shard->lock);
+    if(2 * (shard->count + 1) > shard->capacity) grow_shard(shard);
+
+    InodeKey* slot = find_slot(shard->slots, shard->capacity, hash, dev, ino);
+    bool inserted = slot->ino == EMPTY_INO;
+    if(inserted){
+        slot->dev = dev;
+        slot->ino = ino;
+        shard->count++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return inserted;
+}
@@ -0,0 +1,73 @@
+/**
+ *
+ * This file defines `InodeSet`, a concurrent set of (device, inode) pairs used to
+ * count files with several hard links only once. Only entries with `st_nlink > 1`
+ * are ever inserted, so memory is bounded by the number of hard-linked inodes and
+ * scans of trees without hard links never touch the set.
+ *
+ * The set is split into `INOSET_SHARDS` independently locked open-addressing
+ * tables chosen by the key's hash, so threads inserting different inodes rarely
+ * wait for the same lock. A shard's table is allocated on its first insertion.
+ *
+ * @file inoset.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Sharded concurrent hash set of inodes.
+ */
+
+#ifndef INOSET_H
+#define INOSET_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#define INOSET_SHARD_BITS 6
+#define INOSET_SHARDS (1 << INOSET_SHARD_BITS)
+#define INOSET_INITIAL_CAPACITY 64
+
+typedef struct {
+    uint64_t dev;
+    uint64_t ino;
+} InodeKey;
+
+typedef struct {
+    _Alignas(64) pthread_mutex_t lock;
+    size_t count;
+    size_t capacity;
+    InodeKey* slots;
+} InodeShard;
+
+typedef struct {
+    InodeShard shards[INOSET_SHARDS];
+} InodeSet;
+
+/**
+ * @brief Creates an empty inode set.
+ *
+ * @return A pointer to the new set. Terminates the program if allocation fails.
+ */
+InodeSet* create_inoset(void);
+
+/**
+ * @brief Frees the set and all of its shards.
+ *
+ * @param set Pointer to the set, may be `NULL`.
+ */
+void destroy_inoset(InodeSet* set);
+
+/**
+ * @brief Inserts an inode, reporting whether it was seen before.
+ *
+ * @param set   Pointer to the set.
+ * @param dev   Device holding the inode.
+ * @param ino   Inode number.
+ *
+ * @return true if the inode was not in the set, i.e. this is the first link found.
+ */
+bool inoset_insert(InodeSet* set, dev_t dev, ino_t ino);
+
+#endif
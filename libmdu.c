@@ -0,0 +1,268 @@
+#include "libmdu.h"
+void mdu_default_options(Options* opts){
+    *opts = (Options){ .nthreads = 1, .auto_threads = false, .engine = ENGINE_THREAD, .count_links = false, .one_file_system = false, .device_threads = 0, .max_depth = 0, .cache_path = NULL, .daemon_socket = NULL, .hints_path = NULL, .stats = false, .top = 0, .group_by = GROUP_NONE, .size_histogram = false, .age_histogram = false, .filter = NULL, .split_dirs = 0, .format = FORMAT_TSV, .all = false, .max_queue_mem = 0, .topology = NULL };
+}
+
+MduContext* mdu_create(const Options* opts, const ScanCallbacks* callbacks){
+    MduContext* ctx = malloc(sizeof(MduContext));
+    if(ctx == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    ctx->opts = *opts;
+    if(ctx->opts.engine == ENGINE_URING && !uring_engine_available()) ctx->opts.engine = ENGINE_THREAD;
+    ctx->scan.callbacks = callbacks != NULL ? *callbacks : (ScanCallbacks){ NULL, NULL, NULL, NULL };
+    atomic_init(&ctx->scan.cancelled, false);
+    atomic_init(&ctx->scan.status, SCAN_OK);
+    ctx->collectors = NULL;
+    ctx->hint_collectors = NULL;
+    ctx->peak_threads = 0;
+    init_top(&ctx->top_files, 0);
+    init_top(&ctx->top_dirs, 0);
+    init_accounting(&ctx->account, GROUP_NONE, false, false, 0);
+    return ctx;
+}
+
+static void release_collectors(MduContext* ctx){
+    if(ctx->hint_collectors != NULL){
+        for(int i = 0; i < ctx->opts.nthreads; i++) destroy_hints(&ctx->hint_collectors[i]);
+        free(ctx->hint_collectors);
+        ctx->hint_collectors = NULL;
+    }
+    if(ctx->collectors == NULL) return;
+    for(int i = 0; i < ctx->opts.nthreads; i++) destroy_collector(&ctx->collectors[i]);
+    free(ctx->collectors);
+    ctx->collectors = NULL;
+}
+
+ScanStatus mdu_scan(MduContext* ctx, char* paths[], int npaths, long results[]){
+    const Options* opts = &ctx->opts;
+    int nthreads = opts->nthreads;
+    atomic_store(&ctx->scan.cancelled, false);
+    atomic_store(&ctx->scan.status, SCAN_OK);
+    release_collectors(ctx);
+    destroy_top(&ctx->top_files);
+    destroy_top(&ctx->top_dirs);
+    init_top(&ctx->top_files, opts->top);
+    init_top(&ctx->top_dirs, opts->top);
+    time_t now = time(NULL);
+    destroy_accounting(&ctx->account);
+    init_accounting(&ctx->account, opts->group_by, opts->size_histogram, opts->age_histogram, now);
+
+    //Unchanged directories are not listed from the cache, so their entries would be missing,
+    //and a cached listing holds the names of entries the filter may drop.
+    bool every_entry = opts->top > 0 || ctx->account.enabled || opts->filter != NULL
+        || ctx->scan.callbacks.entry != NULL;
+    Scheduler* sched = create_sched(nthreads);
+    for(int i = 0; opts->topology != NULL && i < nthreads; i++) sched_set_node(sched, i, topology_node(opts->topology, i));
+    InodeSet* inodes = opts->count_links ? NULL : create_inoset();
+    ScanCache* cache = opts->cache_path != NULL && !every_entry ? open_cache(opts->cache_path) : NULL;
+    if(opts->cache_path != NULL || opts->daemon_socket != NULL){
+        ctx->collectors = malloc(nthreads * sizeof(CacheCollector));
+        if(ctx->collectors == NULL){
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for(int i = 0; i < nthreads; i++) init_collector(&ctx->collectors[i]);
+    }
+    Hints hints;
+    init_hints(&hints);
+    if(opts->hints_path != NULL){
+        read_hints(&hints, opts->hints_path);
+        ctx->hint_collectors = malloc(nthreads * sizeof(Hints));
+        if(ctx->hint_collectors == NULL){
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        for(int i = 0; i < nthreads; i++) init_hints(&ctx->hint_collectors[i]);
+    }
+
+    atomic_long* totals = calloc(npaths > 0 ? npaths : 1, sizeof(atomic_long));
+    if(totals == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    queue_initialize(sched, paths, npaths, opts->device_threads == 0 ? nthreads : opts->device_threads, opts->hints_path != NULL ? &hints : NULL);
+
+    extended_Thread workers[nthreads];
+    Tuner* tuner = opts->auto_threads ? start_tuner(sched) : NULL;
+    int started = worker_state_initialize(workers, opts, &ctx->scan, inodes, totals, sched, cache, ctx->collectors, opts->hints_path != NULL ? &hints : NULL, ctx->hint_collectors, now);
+    if(started < nthreads){
+        //The workers already running drain the scan, without any it is freed with the scheduler.
+        ScanError err = { .op = "pthread_create", .parent = NULL, .name = NULL, .error = errno };
+        if(ctx->scan.callbacks.error != NULL) ctx->scan.callbacks.error(ctx->scan.callbacks.user, &err);
+        atomic_store(&ctx->scan.status, SCAN_FAILED);
+        atomic_store(&ctx->scan.cancelled, true);
+    }
+    worker_join(workers, started, &ctx->top_files, &ctx->top_dirs, &ctx->account);
+    if(tuner != NULL) stop_tuner(tuner, &ctx->peak_threads);
+    sort_top(&ctx->top_files);
+    sort_top(&ctx->top_dirs);
+
+    destroy_sched(sched);
+    destroy_hints(&hints);
+    destroy_inoset(inodes);
+    close_cache(cache);
+    for(int i = 0; i < npaths; i++) results[i] = totals[i];
+    free(totals);
+
+    ScanStatus status = atomic_load(&ctx->scan.status);
+    if(status != SCAN_FAILED && atomic_load(&ctx->scan.cancelled)) return SCAN_CANCELLED;
+    return status;
+}
+
+void mdu_cancel(MduContext* ctx){
+    atomic_store(&ctx->scan.cancelled, true);
+}
+
+ScanCache* mdu_collect_cache(MduContext* ctx){
+    return collect_cache(ctx->collectors, ctx->collectors == NULL ? 0 : ctx->opts.nthreads);
+}
+
+int mdu_write_cache(MduContext* ctx, const char* path){
+    return write_cache(path, ctx->collectors, ctx->collectors == NULL ? 0 : ctx->opts.nthreads);
+}
+
+int mdu_write_hints(MduContext* ctx, const char* path){
+    return write_hints(path, ctx->hint_collectors, ctx->hint_collectors == NULL ? 0 : ctx->opts.nthreads);
+}
+
+void mdu_destroy(MduContext* ctx){
+    if(ctx == NULL) return;
+    release_collectors(ctx);
+    destroy_top(&ctx->top_files);
+    destroy_top(&ctx->top_dirs);
+    destroy_accounting(&ctx->account);
+    free(ctx);
+}
+
+int worker_state_initialize(
+        extended_Thread workers[],
+        const Options* opts,
+        ScanState* scan,
+        InodeSet* inodes,
+        atomic_long results[],
+        Scheduler* sched,
+        const ScanCache* cache,
+        CacheCollector collectors[],
+        const Hints* hints,
+        Hints hint_collectors[],
+        time_t now
+    ){
+    void* (*thread_fn)(void*) = opts->engine == ENGINE_URING ? du_uring_thread : du_worker_thread;
+    for(int i = 0; i < opts->nthreads; i++){
+        workers[i].args = (WorkerArgs*) malloc(sizeof(WorkerArgs));
+        if(workers[i].args == NULL){
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        workers[i].args->results            = results;
+        workers[i].args->opts               = opts;
+        workers[i].args->scan               = scan;
+        workers[i].args->sched              = sched;
+        workers[i].args->inodes             = inodes;
+        workers[i].args->cache              = cache;
+        workers[i].args->collector          = collectors == NULL ? NULL : &collectors[i];
+        workers[i].args->hints              = hints;
+        workers[i].args->hint_collector     = hint_collectors == NULL ? NULL : &hint_collectors[i];
+        workers[i].args->stats              = sched_stats(sched, i);
+        init_top(&workers[i].args->top_files, opts->top);
+        init_top(&workers[i].args->top_dirs, opts->top);
+        init_accounting(&workers[i].args->account, opts->group_by, opts->size_histogram, opts->age_histogram, now);
+        init_matcher(&workers[i].args->matcher, opts->filter);
+        workers[i].args->self               = &workers[i];
+        workers[i].args->id                 = i;
+        workers[i].args->nthreads           = opts->nthreads;
+
+        //Pinned before it starts, so the worker's own allocations are local to its node.
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        int result = opts->topology != NULL ? topology_pin(opts->topology, i, &attr) : 0;
+        if(result == 0) result = pthread_create(&workers[i].threadID, &attr, thread_fn, (void*) workers[i].args);
+        pthread_attr_destroy(&attr);
+        if(result != 0){
+            destroy_top(&workers[i].args->top_files);
+            destroy_top(&workers[i].args->top_dirs);
+            destroy_accounting(&workers[i].args->account);
+            destroy_matcher(&workers[i].args->matcher);
+            free(workers[i].args);
+            errno = result;
+            return i;
+        }
+    }
+    return opts->nthreads;
+}
+
+//A rough count of the entries below a path, ext4 and tmpfs use about 32 bytes of a 
+//directory per entry, and every subdirectory adds a link.
+static long estimate_entries(const Hints* hints, const struct stat* st){
+    long entries = hint_lookup(hints, st->st_dev, st->st_ino);
+    if(entries > 0 || !S_ISDIR(st->st_mode)) return entries;
+    return st->st_size / 32 > (long)st->st_nlink ? st->st_size / 32 : (long)st->st_nlink;
+}
+
+void queue_initialize(Scheduler* sched, char* path[], int size, int device_threads, const Hints* hints){
+    if(size == 0) return;
+    int pools[size];
+    long estimate[size];
+    for(int i = 0; i < size; i++){
+        //A path that cannot be stat'ed fails in a worker, with its error message.
+        struct stat st;
+        bool found = lstat(path[i], &st) == 0;
+        dev_t dev = found ? st.st_dev : 0;
+        pools[i] = sched_device_pool(sched, dev, device_threads);
+        estimate[i] = found && hints != NULL ? estimate_entries(hints, &st) : 0;
+    }
+
+    for(int pool = 0; pool < sched->npools; pool++){
+        Entry* entries[size];
+        int n = 0;
+        for(int i = 0; i < size; i++){
+            if(pools[i] != pool) continue;
+            //Largest first, paths with equal estimates keep their order.
+            int at = n++;
+            for(; at > 0 && estimate[entries[at - 1]->index_working_size] < estimate[i]; at--) entries[at] = entries[at - 1];
+            entries[at] = create_entry(NULL, NULL, path[i], i);
+        }
+        sched_inject_batch(sched, pool, entries, n);
+    }
+}
+
+void worker_join(extended_Thread workers[], int nthreads, TopHeap* top_files, TopHeap* top_dirs, Accounting* account){
+    bool stats = STATS_ENABLED && nthreads > 0 && workers[0].args->opts->stats;
+    WorkerStats total;
+    init_stats(&total);
+    if(stats) print_stats_header(stderr);
+
+    for(int i = 0; i < nthreads; i++){
+        int err;
+        if((err = pthread_join(workers[i].threadID, NULL)) != 0){
+            fprintf(stderr, "Failed to join thread %lu, err: %d", workers[i].threadID, err);
+            exit(EXIT_FAILURE);
+        }
+        if(stats){
+            char label[16];
+            snprintf(label, sizeof(label), "%d", i);
+            print_stats(stderr, label, workers[i].args->stats);
+            merge_stats(&total, workers[i].args->stats);
+        }
+        merge_top(top_files, &workers[i].args->top_files);
+        merge_top(top_dirs, &workers[i].args->top_dirs);
+        destroy_top(&workers[i].args->top_files);
+        destroy_top(&workers[i].args->top_dirs);
+        merge_accounting(account, &workers[i].args->account);
+        destroy_accounting(&workers[i].args->account);
+        destroy_matcher(&workers[i].args->matcher);
+        free(workers[i].args);
+    }
+
+    if(stats){
+        print_stats(stderr, "total", &total);
+        if(total.largest_dir_path != NULL){
+            fprintf(stderr, "largest directory: %ld entries in %s\n", total.largest_dir, total.largest_dir_path);
+        }
+    }
+    destroy_stats(&total);
+}
@@ -0,0 +1,231 @@
+/**
+ *
+ * This file defines libmdu, the scanning engine of mdu as a library, built as
+ * `libmdu.a` and `libmdu.so` by `make lib`. The `mdu` command is a thin wrapper
+ * around it, see mdu.h.
+ *
+ * A `MduContext` holds the options and callbacks of the scans made with it. Every
+ * `mdu_scan` sets up its own scheduler, workers and inode set and tears them down
+ * before returning, so contexts are independent of each other and one context
+ * runs any number of scans one after another. The scan blocks the calling thread
+ * while results stream out of the workers through the callbacks, see
+ * `ScanCallbacks` in du_worker.h, and `mdu_cancel` stops it from any thread,
+ * including from a callback.
+ *
+ * File system errors never terminate the process. Each one is passed to the
+ * `error` callback, which decides whether the scan skips the entry or stops, and
+ * the outcome of the scan is returned as a `ScanStatus`. Failure to allocate
+ * memory still terminates the program, as everywhere else in mdu.
+ *
+ * Example:
+ *   Options opts;
+ *   mdu_default_options(&opts);
+ *   opts.nthreads = 8;
+ *   ScanCallbacks cb = { .directory = on_directory, .user = state };
+ *   MduContext* ctx = mdu_create(&opts, &cb);
+ *   long total;
+ *   char* paths[] = { "/srv" };
+ *   if(mdu_scan(ctx, paths, 1, &total) == SCAN_OK) ...
+ *   mdu_destroy(ctx);
+ *
+ * @file libmdu.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Embeddable parallel disk usage scanner.
+ */
+
+#ifndef LIBMDU_H
+#define LIBMDU_H
+
+#include "du_worker.h"
+#include "du_uring.h"
+#include "scheduler.h"
+#include "tuner.h"
+#include "cache.h"
+#include "inoset.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/**
+ * @note `collectors` holds the directories recorded by the last scan when
+ *       `cache_path` or `daemon_socket` is set, otherwise it is `NULL`.
+ * @note `hint_collectors` holds the subtree sizes recorded by the last scan when 
+ *       `hints_path` is set, otherwise it is `NULL`.
+ * @note `peak_threads` is the largest number of workers active at once during the
+ *       last scan with `-j auto`.
+ * @note `top_files` and `top_dirs` hold the `top` largest files and directories
+ *       below the paths of the last scan, sorted largest first.
+ * @note `account` holds the usage of the last scan split by `group_by` and the 
+ *       histograms, see account.h.
+ */
+typedef struct {
+    Options opts;
+    ScanState scan;
+    CacheCollector* collectors;
+    Hints* hint_collectors;
+    int peak_threads;
+    TopHeap top_files;
+    TopHeap top_dirs;
+    Accounting account;
+} MduContext;
+
+/**
+ * @brief Fills in the options of a plain `mdu` run.
+ *
+ * One thread engine worker, hard links counted once, no depth, cache or limits.
+ *
+ * @param opts Pointer to the options to fill in.
+ */
+void mdu_default_options(Options* opts);
+
+/**
+ * @brief Creates a context.
+ *
+ * The uring engine is replaced by the thread engine if io_uring is not available.
+ *
+ * @param opts      The options of every scan, copied.
+ * @param callbacks The callbacks of every scan, copied, `NULL` for none.
+ *
+ * @return The context, freed with `mdu_destroy`.
+ */
+MduContext* mdu_create(const Options* opts, const ScanCallbacks* callbacks);
+
+/**
+ * @brief Scans a list of paths.
+ *
+ * Blocks until every worker has returned, the callbacks are not called anymore
+ * once it returns. With `top`, any accounting option, a `filter` or an `entry`
+ * callback set the previous cache is not read, since it would miss the entries of
+ * unchanged directories or hold entries the filter drops. The new cache is still recorded, with a filter
+ * it only holds the entries kept.
+ *
+ * @param ctx       Pointer to the context.
+ * @param paths     The paths to scan.
+ * @param npaths    Number of paths.
+ * @param results   Receives the total in blocks of every path, only meaningful
+ *                  when `SCAN_OK` or `SCAN_PARTIAL` is returned.
+ *
+ * @return `SCAN_OK`, `SCAN_PARTIAL` if the `error` callback skipped entries,
+ *         `SCAN_CANCELLED` after `mdu_cancel` or `SCAN_FAILED` if an error stopped
+ *         the scan.
+ */
+ScanStatus mdu_scan(MduContext* ctx, char* paths[], int npaths, long results[]);
+
+/**
+ * @brief Cancels the running scan.
+ *
+ * Workers retire the entries left without looking at them, `mdu_scan` returns
+ * `SCAN_CANCELLED` shortly after. Safe to call from any thread.
+ *
+ * @param ctx Pointer to the context.
+ */
+void mdu_cancel(MduContext* ctx);
+
+/**
+ * @brief Builds an in-memory cache of the directories recorded by the last scan.
+ *
+ * @param ctx Pointer to the context, with `cache_path` or `daemon_socket` set.
+ *
+ * @return The cache, released with `close_cache`, see cache.h.
+ */
+ScanCache* mdu_collect_cache(MduContext* ctx);
+
+/**
+ * @brief Writes the directories recorded by the last scan to a cache file.
+ *
+ * @param ctx  Pointer to the context, with `cache_path` or `daemon_socket` set.
+ * @param path Path of the cache file.
+ *
+ * @return 0 on success, -1 with `errno` set on failure.
+ */
+int mdu_write_cache(MduContext* ctx, const char* path);
+
+/**
+ * @brief Writes the subtree sizes recorded by the last scan to a hints file.
+ *
+ * @param ctx  Pointer to the context, with `hints_path` set.
+ * @param path Path of the hints file.
+ *
+ * @return 0 on success, -1 with `errno` set on failure.
+ */
+int mdu_write_hints(MduContext* ctx, const char* path);
+
+/**
+ * @brief Frees a context.
+ *
+ * @param ctx Pointer to the context, may be `NULL`. No scan may be running.
+ */
+void mdu_destroy(MduContext* ctx);
+
+/**
+ * @brief Initializes worker threads and their arguments.
+ *
+ * Allocates and initializes the necessary structures for each worker thread, including
+ * argument data, and starts the threads. Every worker is handed the shared scheduler
+ * together with its own index, which selects the deque it pushes discovered entries to.
+ * The thread function is chosen by the engine in `opts`.
+ *
+ * @param workers          Array of extended_Thread structures representing the workers.
+ * @param opts             Parsed options, `opts->nthreads` workers are started.
+ * @param scan             State shared by the workers of the scan.
+ * @param inodes           Shared set of counted hard-linked inodes, `NULL` to count every link.
+ * @param results          Array for storing results from the worker threads.
+ * @param sched            Scheduler handing out entries, created for `opts->nthreads` workers.
+ * @param cache            The previous scan's cache, may be `NULL`.
+ * @param collectors       One collector per worker recording the new cache, `NULL` without
+ *                         `--cache` or `--daemon`.
+ * @param hints            Subtree sizes read from `--hints`, `NULL` without it.
+ * @param hint_collectors  One set of hints per worker recording the new ones, `NULL` 
+ *                         without `--hints`.
+ * @param now              Time the ages of `--histogram=age` are measured from.
+ *
+ * @return The number of workers started, less than `opts->nthreads` if a thread
+ *         could not be created, with `errno` set.
+ *
+ * @note A reference to allocated arguments is stored in `workers[i].args`, freed
+ *       by `worker_join`.
+ */
+int worker_state_initialize(extended_Thread workers[], const Options* opts, ScanState* scan, InodeSet* inodes, atomic_long results[], Scheduler* sched, const ScanCache* cache, CacheCollector collectors[], const Hints* hints, Hints hint_collectors[], time_t now);
+
+/**
+ * @brief Initializes the scheduler with a list of paths.
+ *
+ * Every path is assigned to the pool of its device, then the entries of each pool
+ * are injected as a single batch. The index of the path is the index of the
+ * result its size is accumulated into.
+ *
+ * @param sched          Pointer to the Scheduler to seed.
+ * @param path           Array of strings to be scheduled.
+ * @param size           Number of elements in the path array.
+ * @param device_threads Most workers scanning one device at a time.
+ * @param hints          Subtree sizes read from `--hints`, `NULL` to keep the paths 
+ *                       in order. With hints the paths of a pool are injected 
+ *                       largest first, by their hint or, for a directory without 
+ *                       one, by the entries its `st_nlink` and `st_size` suggest.
+ *
+ * @note Must be called before the workers are started, see `sched_next`.
+ */
+void queue_initialize(Scheduler* sched, char* path[], int size, int device_threads, const Hints* hints);
+
+/**
+ * @brief Joins an array of worker threads and releases their arguments.
+ *
+ * Every worker's heaps of the largest entries are merged into `top_files` and 
+ * `top_dirs`, its accounting into `account`. With `--stats` every worker's counters and their total are printed 
+ * to stderr.
+ *
+ * @param workers   Array of extended_Thread structures representing the worker threads.
+ * @param nthreads  Number of worker threads to join.
+ * @param top_files Receives the largest files found by the workers.
+ * @param top_dirs  Receives the largest directories found by the workers.
+ * @param account   Receives the accounting of the workers.
+ *
+ * @note If a thread fails to join, the function prints an error message to stderr
+ *       and terminates the program.
+ */
+void worker_join(extended_Thread workers[], int nthreads, TopHeap* top_files, TopHeap* top_dirs, Accounting* account);
+
+#endif
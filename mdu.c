@@ -1,87 +1,130 @@
 #include "mdu.h"
-int main(int argc, char* argv[]){
-    int nthreads = 1;
-    sem_t sem_queue;
-    int optind = handle_user_input(argc, argv, &nthreads);
-    extended_Thread workers[nthreads];
-    atomic_short active_threads = nthreads;
+static void print_directory(void* user, const DirRef* dir, long total){
+    //Command line paths are printed once the scan is done.
+    if(dir->depth == 0) return;
+    write_record((Writer*)user, RECORD_DIR, dir->parent, dir->name, total);
+}
+
+static void print_entry(void* user, const DirRef* parent, const char* name, long blocks){
+    //A file given on the command line is printed with the totals.
+    if(parent == NULL) return;
+    write_record((Writer*)user, RECORD_FILE, parent, name, blocks);
+}
 
+static bool print_error(void* user, const ScanError* err){
+    (void)user;
+    if(is_denied_directory(err)){
+        char* path = build_path(err->parent, err->name);
+        fprintf(stderr, "du: cannot read directory '%s': Permission denied\n", path);
+        free(path);
+        return true;
+    }
+
+    if(err->op == NULL){
+        char* path = build_path(err->parent, err->name);
+        fprintf(stderr,"resource at %s was of an unexpected type, exiting.\n", path);
+        free(path);
+    } else if(err->name == NULL){
+        fprintf(stderr, "%s: %s\n", err->op, strerror(err->error));
+    } else {
+        errno = err->error;
+        perror_at(err->op, err->parent, err->name);
+    }
+    return false;
+}
 
-    if(sem_init(&sem_queue, 0, 0) == -1){
-        perror("semaphore");
+static void add_rule(Options* opts, FilterSyntax syntax, bool include, const char* pattern){
+    if(opts->filter == NULL) opts->filter = create_filter();
+    int err = filter_add(opts->filter, syntax, include, pattern);
+    if(err != 0){
+        char msg[128];
+        regerror(err, NULL, msg, sizeof(msg));
+        fprintf(stderr, "Invalid regular expression %s, %s\n", pattern, msg);
         exit(EXIT_FAILURE);
     }
+}
+
+static void print_top(const char* title, const TopHeap* h){
+    printf("%s:\n", title);
+    for(int i = 0; i < h->n; i++) printf("%ld\t%s\n", h->entries[i].size, h->entries[i].path);
+}
+
+int main(int argc, char* argv[]){
+    Options opts;
+    mdu_default_options(&opts);
+    int optind = handle_user_input(argc, argv, &opts);
+    raise_fd_limit();
+
+    if(opts.engine == ENGINE_URING && !uring_engine_available()){
+        fprintf(stderr, "mdu: io_uring is not available, using the thread engine.\n");
+        opts.engine = ENGINE_THREAD;
+    }
 
-    Queue* queued_entries = create_q();
+    Writer* writer = start_writer(STDOUT_FILENO, opts.format);
+    ScanCallbacks callbacks = { .entry = opts.all ? print_entry : NULL, .directory = print_directory, .error = print_error, .user = writer };
+    MduContext* ctx = mdu_create(&opts, &callbacks);
     
     int npaths = argc - optind;
     char* paths[npaths];
     slice(argv, optind, argc, paths);
-    
-    atomic_long results[npaths];
-    memset(results, 0, sizeof(atomic_long) * npaths);
-
-    queue_initialize(
-        queued_entries, 
-        paths, 
-        npaths, 
-        &sem_queue
-    );
-
-    worker_state_initialize(    
-        workers, 
-        nthreads, 
-        &active_threads,
-        results, 
-        &sem_queue, 
-        queued_entries
-    );
-
-    int status = EXIT_SUCCESS;
-    worker_join(workers, nthreads, &status);
-    sem_destroy(&sem_queue);
-    destroy_q(queued_entries);
+    long results[npaths];
 
+    ScanStatus scanned = mdu_scan(ctx, paths, npaths, results);
+    if(scanned == SCAN_FAILED || scanned == SCAN_CANCELLED){
+        stop_writer(writer);
+        mdu_destroy(ctx);
+        destroy_filter(opts.filter);
+        destroy_topology(opts.topology);
+        return EXIT_FAILURE;
+    }
+    int status = scanned == SCAN_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+    if(opts.auto_threads && opts.stats) fprintf(stderr, "auto: at most %d of %d workers active\n", ctx->peak_threads, opts.nthreads);
+
+    if(opts.cache_path != NULL && mdu_write_cache(ctx, opts.cache_path) == -1){
+        perror(opts.cache_path);
+        status = EXIT_FAILURE;
+    }
+    if(opts.hints_path != NULL && mdu_write_hints(ctx, opts.hints_path) == -1){
+        perror(opts.hints_path);
+        status = EXIT_FAILURE;
+    }
+
+    //Every directory record goes out before the totals.
+    flush_writer(writer);
     for(int i = 0; i < npaths; i++){
-        printf("%ld\t%s\n", results[i], paths[i]);
+        write_record(writer, RECORD_TOTAL, NULL, paths[i], results[i]);
     } 
-    return status;
-}
-
-void worker_state_initialize(
-        extended_Thread workers[], 
-        int nthreads, 
-        atomic_short* active_threads, 
-        atomic_long results[], 
-        sem_t* sem_queue, 
-        Queue* queued_entries
-    ){
-    pthread_mutex_t* shared_mutex = (pthread_mutex_t*)malloc(sizeof(pthread_mutex_t));
-    pthread_mutex_init(shared_mutex, NULL);
-    for(int i = 0; i < nthreads; i++){
-        workers[i].args = (WorkerArgs*) malloc(sizeof(WorkerArgs));
-        if(workers[i].args == NULL){
-            perror("malloc");
-            exit(EXIT_FAILURE);
-        }
+    if(stop_writer(writer) == -1){
+        perror("write");
+        status = EXIT_FAILURE;
+    }
+    if(opts.top > 0){
+        print_top("largest files", &ctx->top_files);
+        print_top("largest directories", &ctx->top_dirs);
+    }
+    if(ctx->account.enabled) print_accounting(stdout, &ctx->account);
 
-        workers[i].args->results            = results;
-        workers[i].args->active_threads     = active_threads;
-        workers[i].args->sem_queue          = sem_queue;
-        workers[i].args->queued_entries     = queued_entries;
-        workers[i].args->self               = &workers[i];
-        workers[i].args->nthreads           = nthreads;
-        workers[i].args->shared_mutex       = shared_mutex;
-    
-        int result = pthread_create(&workers[i].threadID, NULL, du_worker_thread, (void*) workers[i].args);
-        if(result != 0){
-            exit(EXIT_FAILURE);
-        }
+    if(opts.daemon_socket != NULL){
+        fflush(stdout);
+        ScanCache* scan = mdu_collect_cache(ctx);
+        mdu_destroy(ctx);
+        ctx = NULL;
+        if(run_daemon(opts.daemon_socket, paths, npaths, scan) != EXIT_SUCCESS) status = EXIT_FAILURE;
+        close_cache(scan);
     }
+
+    mdu_destroy(ctx);
+    destroy_filter(opts.filter);
+    destroy_topology(opts.topology);
+    return status;
 }
 
-void queue_initialize(Queue* q, char* path[], int size, sem_t* sem_queue){
-    for(int i = 0; i < size; i++) push_q(q, path[i], sem_queue, i);
+void raise_fd_limit(void){
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == -1) return;
+    if(limit.rlim_cur == limit.rlim_max) return;
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
 }
 
 void slice(char* strings[], int start, int len, char* result[]){
@@ -92,36 +135,71 @@ void slice(char* strings[], int start, int len, char* result[]){
     } 
 }
 
-
-void worker_join(extended_Thread workers[], int nthreads, int* status){
-    pthread_mutex_t* shared_mutex = workers[0].args->shared_mutex;
-    for(int i = 0; i < nthreads; i++){
-        void* ret_val;
-        int err;
-        if((err = pthread_join(workers[i].threadID, &ret_val)) != 0){
-            fprintf(stderr, "Failed to join thread %lu, err: %d", workers[i].threadID, err);
-            exit(EXIT_FAILURE);
-        }
-        free(workers[i].args);
-        if (ret_val != NULL) {
-            //If a non-success has been detected, quit inspecting.
-            if(*status == EXIT_SUCCESS)
-                *status = *(int*)ret_val;
-            free(ret_val);
-        }
+//Parses a number of bytes with an optional K, M or G suffix, -1 if it is not one.
+static long parse_bytes(const char* s){
+    char* end;
+    errno = 0;
+    long n = strtol(s, &end, 10);
+    if(errno != 0 || end == s || !isdigit(s[0])) return -1;
+    int shift = 0;
+    switch (toupper(*end)) {
+        case 'K': shift = 10; end++; break;
+        case 'M': shift = 20; end++; break;
+        case 'G': shift = 30; end++; break;
     }
-    pthread_mutex_destroy(shared_mutex);
-    free(shared_mutex);
+    if(*end != '\0' || n > LONG_MAX >> shift) return -1;
+    return n << shift;
 }
 
-int handle_user_input(int argc, char* argv[], int* nthreads){
+int handle_user_input(int argc, char* argv[], Options* opts){
+    static const struct option long_options[] = {
+        { "engine", required_argument, NULL, 'E' },
+        { "count-links", no_argument, NULL, 'l' },
+        { "max-depth", required_argument, NULL, 'd' },
+        { "dirs", no_argument, NULL, 'D' },
+        { "cache", required_argument, NULL, 'C' },
+        { "daemon", required_argument, NULL, 'S' },
+        { "stats", no_argument, NULL, 's' },
+        { "one-file-system", no_argument, NULL, 'x' },
+        { "device-threads", required_argument, NULL, 'T' },
+        { "top", required_argument, NULL, 'N' },
+        { "group-by", required_argument, NULL, 'G' },
+        { "histogram", required_argument, NULL, 'H' },
+        { "exclude", required_argument, NULL, 'e' },
+        { "include", required_argument, NULL, 'i' },
+        { "exclude-regex", required_argument, NULL, 'r' },
+        { "include-regex", required_argument, NULL, 'R' },
+        { "split-dirs", required_argument, NULL, 'P' },
+        { "max-queue-mem", required_argument, NULL, 'M' },
+        { "cpus", required_argument, NULL, 'c' },
+        { "numa", no_argument, NULL, 'n' },
+        { "hints", required_argument, NULL, 'I' },
+        { "format", required_argument, NULL, 'F' },
+        { "all", no_argument, NULL, 'a' },
+        { NULL, 0, NULL, 0 },
+    };
     int opt;
     int i, isNum;
     isNum = 1;
-    while((opt = getopt(argc, argv, "j:")) != -1){
+    bool depth_given = false;
+    const char* cpus = NULL;
+    bool numa = false;
+    while((opt = getopt_long(argc, argv, "j:ld:xa", long_options, NULL)) != -1){
         switch (opt)
         {
         case 'j':
+            if(strncmp(optarg, "auto", 4) == 0){
+                opts->auto_threads = true;
+                opts->nthreads = tuner_default_max();
+                if(optarg[4] == '\0') break;
+                for(i = 5; optarg[i] != '\0' && isdigit(optarg[i]); i++);
+                if(optarg[4] != ':' || i == 5 || optarg[i] != '\0' || atoi(optarg + 5) < 1){
+                    fprintf(stderr, "Provided cap of -j auto was not a positive number, %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                opts->nthreads = atoi(optarg + 5);
+                break;
+            }
             i = strlen(optarg) - 1;
             while(i >= 0){
                 isNum = isdigit(optarg[i]);
@@ -129,22 +207,196 @@ int handle_user_input(int argc, char* argv[], int* nthreads){
                 else i = -1;
             } 
             
-            if(isNum) (*nthreads) = atoi(optarg);
+            if(isNum) opts->nthreads = atoi(optarg);
             else{
                 fprintf(stderr, "Provided number of threads was not a number, %s\n", optarg);
                 exit(EXIT_FAILURE);
             }
             
-            if((*nthreads) < 1){
+            if(opts->nthreads < 1){
                 fprintf(stderr, "Number of threads must be greater than 1. \n");
                 exit(EXIT_FAILURE);
             }
             break;
+
+        case 'l':
+            opts->count_links = true;
+            break;
+
+        case 'x':
+            opts->one_file_system = true;
+            break;
+
+        case 'T':
+            for(i = 0; optarg[i] != '\0' && isdigit(optarg[i]); i++);
+            if(i == 0 || optarg[i] != '\0' || atoi(optarg) < 1){
+                fprintf(stderr, "Provided number of threads per device was not a positive number, %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            opts->device_threads = atoi(optarg);
+            break;
+
+        case 'N':
+            for(i = 0; optarg[i] != '\0' && isdigit(optarg[i]); i++);
+            if(i == 0 || optarg[i] != '\0' || atoi(optarg) < 1){
+                fprintf(stderr, "Provided number of entries for --top was not a positive number, %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            opts->top = atoi(optarg);
+            break;
+
+        case 'G':
+            if(strcmp(optarg, "uid") == 0) opts->group_by = GROUP_UID;
+            else if(strcmp(optarg, "gid") == 0) opts->group_by = GROUP_GID;
+            else if(strcmp(optarg, "ext") == 0) opts->group_by = GROUP_EXT;
+            else{
+                fprintf(stderr, "Unknown grouping %s, expected uid, gid or ext\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'H':
+            if(strcmp(optarg, "size") == 0) opts->size_histogram = true;
+            else if(strcmp(optarg, "age") == 0) opts->age_histogram = true;
+            else{
+                fprintf(stderr, "Unknown histogram %s, expected size or age\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'e':
+            add_rule(opts, FILTER_GLOB, false, optarg);
+            break;
+
+        case 'i':
+            add_rule(opts, FILTER_GLOB, true, optarg);
+            break;
+
+        case 'r':
+            add_rule(opts, FILTER_REGEX, false, optarg);
+            break;
+
+        case 'R':
+            add_rule(opts, FILTER_REGEX, true, optarg);
+            break;
+
+        case 'P':
+            for(i = 0; optarg[i] != '\0' && isdigit(optarg[i]); i++);
+            if(i == 0 || optarg[i] != '\0' || atol(optarg) < 1){
+                fprintf(stderr, "Provided number of entries for --split-dirs was not a positive number, %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            opts->split_dirs = atol(optarg);
+            break;
+
+        case 'M':
+            opts->max_queue_mem = parse_bytes(optarg);
+            if(opts->max_queue_mem < 1){
+                fprintf(stderr, "Provided size for --max-queue-mem was not a positive number of bytes, %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'c':
+            cpus = optarg;
+            break;
+
+        case 'n':
+            numa = true;
+            break;
+
+        case 'd':
+            for(i = 0; optarg[i] != '\0' && isdigit(optarg[i]); i++);
+            if(i == 0 || optarg[i] != '\0'){
+                fprintf(stderr, "Provided depth was not a number, %s\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            opts->max_depth = atoi(optarg);
+            depth_given = true;
+            break;
+
+        case 'D':
+            opts->max_depth = INT_MAX;
+            depth_given = true;
+            break;
+
+        case 'a':
+            opts->all = true;
+            break;
+
+        case 'F':
+            if(strcmp(optarg, "tsv") == 0) opts->format = FORMAT_TSV;
+            else if(strcmp(optarg, "ndjson") == 0) opts->format = FORMAT_NDJSON;
+            else if(strcmp(optarg, "bin") == 0) opts->format = FORMAT_BIN;
+            else{
+                fprintf(stderr, "Unknown format %s, expected tsv, ndjson or bin\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
+
+        case 'C':
+            opts->cache_path = optarg;
+            break;
+
+        case 'S':
+            opts->daemon_socket = optarg;
+            break;
+
+        case 'I':
+            opts->hints_path = optarg;
+            break;
+
+        case 's':
+            if(!STATS_ENABLED) fprintf(stderr, "mdu: built without MDU_STATS, --stats has no counters to print, rebuild with make STATS=1\n");
+            opts->stats = true;
+            break;
+
+        case 'E':
+            if(strcmp(optarg, "thread") == 0) opts->engine = ENGINE_THREAD;
+            else if(strcmp(optarg, "uring") == 0) opts->engine = ENGINE_URING;
+            else{
+                fprintf(stderr, "Unknown engine %s, expected thread or uring\n", optarg);
+                exit(EXIT_FAILURE);
+            }
+            break;
         
         default:
-            fprintf(stderr, "Usage: mdu [-j number_threads] file ... \n");
+            fprintf(stderr, "Usage: mdu [-j number_threads|auto[:max]] [-l] [-x] [-a] [--device-threads=N] [-d depth | --dirs] [--format=tsv|ndjson|bin] [--top=N] [--group-by=uid|gid|ext] [--histogram=size|age] [--exclude=GLOB] [--include=GLOB] [--exclude-regex=RE] [--include-regex=RE] [--split-dirs=N] [--max-queue-mem=BYTES] [--cpus=LIST] [--numa] [--engine=thread|uring] [--cache=FILE] [--hints=FILE] [--daemon=SOCKET] [--stats] file ... \n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    //As with du, -a alone lists everything.
+    if(opts->all && !depth_given) opts->max_depth = INT_MAX;
+    if(opts->format != FORMAT_TSV && (opts->top > 0 || opts->group_by != GROUP_NONE || opts->size_histogram || opts->age_histogram)){
+        fprintf(stderr, "--top, --group-by and --histogram are only printed with --format=tsv\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //A cache recorded with rules would be read back by runs without them.
+    if(opts->filter != NULL && (opts->cache_path != NULL || opts->daemon_socket != NULL)){
+        fprintf(stderr, "--exclude and --include cannot be combined with --cache or --daemon\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if(cpus != NULL || numa){
+        opts->topology = create_topology(cpus, numa);
+        if(opts->topology == NULL){
+            fprintf(stderr, "Provided CPU list was not a list of CPUs this process may run on, %s\n", cpus != NULL ? cpus : "");
             exit(EXIT_FAILURE);
         }
     }
+
+    //The cache records a directory's names in one piece, its listing cannot pause.
+    if(opts->max_queue_mem > 0 && (opts->cache_path != NULL || opts->daemon_socket != NULL)){
+        fprintf(stderr, "--max-queue-mem cannot be combined with --cache or --daemon\n");
+        exit(EXIT_FAILURE);
+    }
+
+    //Directories replayed from the cache are not listed, their entries would be missing from the hints.
+    if(opts->hints_path != NULL && (opts->cache_path != NULL || opts->daemon_socket != NULL)){
+        fprintf(stderr, "--hints cannot be combined with --cache or --daemon\n");
+        exit(EXIT_FAILURE);
+    }
     return optind;
-}
\ No newline at end of file
+}
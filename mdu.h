@@ -5,9 +5,13 @@
  * of threads to use for processing through command line arguments.
  *
  * The main components of the application include:
- * - **Queue**: A thread-safe queue for managing file paths to be processed.
- * - **Workers**: Threads that execute file processing tasks, utilizing the queue.
- * - **Main thread**: Manages workers using user input and displays the result.
+ * - **Scheduler**: Per-worker work-stealing deques, fed by a thread-safe queue 
+ *   holding the paths given on the command line.
+ * - **Workers**: Threads that execute file processing tasks, utilizing the scheduler.
+ * - **libmdu**: Runs a scan with the workers and streams its results through 
+ *   callbacks, see libmdu.h.
+ * - **Main thread**: Parses user input, prints directories and errors from the 
+ *   callbacks of the scan and displays the result.
  * 
  * The program processes files by splitting the workload across multiple threads, 
  * which enhances performance for large datasets. The results of processing are 
@@ -17,11 +21,73 @@
  * @file mdu.c
  * @brief Multi-threaded file processing application.
  * @note The program requires the `-j` option to specify the number of threads. 
- *       If not provided, it defaults to one thread.
+ *       If not provided, it defaults to one thread. `-j auto` starts with two active 
+ *       workers and adapts their number to the measured throughput, up to four per 
+ *       CPU or the cap given as `-j auto:N`, see tuner.h.
+ * @note A file with several hard links is counted once, for the first link found. 
+ *       `-l`/`--count-links` counts it once per link instead.
+ * @note Paths on different devices are scanned by separate pools of the scheduler, 
+ *       `--device-threads=N` allows at most N workers on one device at a time. 
+ *       `-x`/`--one-file-system` skips directories on other devices than the path 
+ *       they were found below.
+ * @note `-d N`/`--max-depth=N` also prints the total of every directory at most N 
+ *       levels below a command line path, `--dirs` prints all of them. The totals 
+ *       are computed in the same pass and printed as each directory completes.
+ * @note `-a`/`--all` also prints every file, within `-d` if given, otherwise 
+ *       everything as `du -a`. `--format=ndjson|bin` streams the records as JSON 
+ *       lines or binary records instead of `du`'s tab separated lines. Records are 
+ *       formatted by the workers into buffers of their own and written by a 
+ *       separate thread while the scan runs, see writer.h. `--top`, `--group-by` 
+ *       and `--histogram` are only printed in the default format.
+ * @note `--top=N` also prints the N largest files and the N largest directories 
+ *       below the paths, by subtree total, after the totals. Each worker keeps its 
+ *       own bounded heaps, merged once the workers are joined, see top.h.
+ * @note `--group-by=uid|gid|ext` also prints the usage split by owner, group or 
+ *       file extension, `--histogram=size` and `--histogram=age`, which may both 
+ *       be given, the number and usage of files by size and by age. Both are 
+ *       collected in the same pass from the status already read for every entry, 
+ *       see account.h.
+ * @note `--exclude=GLOB` skips every entry whose name matches, together with 
+ *       everything below it, without opening, sizing or queueing it, 
+ *       `--exclude-regex=RE` does the same for a regular expression. 
+ *       `--include=GLOB` and `--include-regex=RE` keep matching entries, the first 
+ *       rule on the command line that matches a name decides, see filter.h.
+ * @note `--split-dirs=N` hands the files after the first N entries of a directory 
+ *       to the other workers while the directory is still being read, so a huge 
+ *       flat directory is sized by every worker instead of the one listing it. 
+ *       Directories are not split with `--cache` or `--daemon`.
+ * @note `--max-queue-mem=BYTES`, with an optional K, M or G suffix, pauses the 
+ *       listing of a directory once the entries waiting in the scheduler take more 
+ *       than BYTES, and lists on once the workers caught up, see du_worker.h. The 
+ *       bound is soft, every worker may exceed it by the entries of one read of a 
+ *       directory. It cannot be combined with `--cache` or `--daemon`.
+ * @note `--cpus=LIST`, as in `0-3,8`, pins every worker to one CPU of LIST. 
+ *       `--numa` deals the workers round robin over the NUMA nodes, pins them to 
+ *       their node and lets them steal from workers on the same node first. A 
+ *       worker's own memory is then allocated on its node, see topology.h.
+ * @note `--engine=uring` replaces the blocking workers with io_uring workers, each 
+ *       keeping many statx requests in flight, see du_uring.h. If io_uring is not 
+ *       available the thread engine is used instead.
+ * @note `--cache=FILE` keeps a record of every directory in FILE, and a later run 
+ *       with the same FILE skips listing directories that did not change, see cache.h. 
+ *       The file is rewritten after every run.
+ * @note `--hints=FILE` keeps the number of entries below every large directory in 
+ *       FILE. A later run with the same FILE schedules the directories recorded 
+ *       there ahead of everything else, so their subtrees are split over the 
+ *       workers early, and injects the command line paths largest first, see 
+ *       hints.h. The file is rewritten after every run. It cannot be combined with 
+ *       `--cache` or `--daemon`.
+ * @note `--daemon=SOCKET` keeps running after printing the totals, watching the 
+ *       scanned trees with inotify and answering queries for the current total of 
+ *       any directory on the Unix domain socket SOCKET, see daemon.h.
+ * @note `--stats` prints per-worker counters of system calls, idle and queue time 
+ *       to stderr once the workers are joined. The counters are only compiled in 
+ *       with `make STATS=1`, see stats.h.
  *
  * To run:
- *   ./mdu [-j number_threads] file1 file2 ...
+ *   ./mdu [-j number_threads|auto[:max]] [-l] [-x] [-a] [--device-threads=N] [-d depth | --dirs] [--format=tsv|ndjson|bin] [--top=N] [--group-by=uid|gid|ext] [--histogram=size|age] [--exclude=GLOB] [--include=GLOB] [--exclude-regex=RE] [--include-regex=RE] [--split-dirs=N] [--max-queue-mem=BYTES] [--cpus=LIST] [--numa] [--engine=thread|uring] [--cache=FILE] [--hints=FILE] [--daemon=SOCKET] [--stats] file1 file2 ...
  *
+ * @see scheduler.h for scheduler implementation details.
  * @see queue.h for queue implementation details.
  * @see worker.h for worker thread management.
  *
@@ -37,8 +103,8 @@
 #ifndef MDU_H
 #define MDU_H
 
-#include "du_worker.h"
-#include "queue.h"
+#include "libmdu.h"
+#include "daemon.h"
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -49,85 +115,44 @@
 #include <semaphore.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <sys/resource.h>
 
 /**
- * @brief Parses and validates user input for thread count and files.
+ * @brief Parses and validates user input for options and files.
  *
  * This function processes command-line arguments, extracts the number of threads 
  * specified with the `-j` option, and ensures the provided value is a valid positive 
- * integer. If the input is invalid or a usage error occurs, an error message is 
- * displayed and the program exits. The remaining command-line arguments after the 
- * `-j` option are considered file inputs.
+ * integer or `auto`, optionally followed by `:` and a cap. The engine is selected with `--engine=thread|uring`, `-l` disables 
+ * hard link deduplication, `-x` stays on the devices of the paths, 
+ * `--device-threads` limits the workers per device, `-d`/`--max-depth` or `--dirs` 
+ * select which directories are printed, `-a` adds files, `--format` the output format, `--top` how many of the largest entries, `--group-by` and `--histogram` the accounting printed, `--exclude` and `--include` the entries skipped, `--split-dirs` when directories are split, `--max-queue-mem` the memory of scheduled entries, `--cpus` and `--numa` the placement of the workers, `--cache` names the scan cache, `--hints` the file of subtree sizes, `--daemon` the socket 
+ * of the watch daemon and `--stats` requests the worker counters. If the input is 
+ * invalid or a usage error occurs, an error message is displayed and the program 
+ * exits. The remaining command-line arguments after the options are considered 
+ * file inputs.
  *
  * @param argc      The argument count, representing the total number of command-line arguments.
  * @param argv      Array of command-line arguments.
- * @param nthreads  Pointer to an integer that will store the number of threads specified by the user.
+ * @param opts      Pointer to the options to fill in, holding the defaults on entry.
  *
  * @return The index of the first non-option argument (file).
  *
- * @note The function terminates the program if an invalid number of threads is provided 
- *       or if the number of threads is less than 1.
+ * @note The function terminates the program if an invalid number of threads is provided, 
+ *       if the number of threads, threads per device, `--top` or `--split-dirs` entries is less than 1, if the depth is not a number or 
+ *       if the engine, format, grouping or histogram is unknown, if `--top`, `--group-by` or `--histogram` 
+ *       is combined with another format than tsv, if a regular expression is invalid, if `--max-queue-mem` is not a positive size, if the CPU list names no usable CPU or if 
+ *       rules or `--max-queue-mem` are combined with `--cache` or `--daemon`.
  */
-int handle_user_input(int argc, char* argv[], int* nthreads);
+int handle_user_input(int argc, char* argv[], Options* opts);
 
 /**
- * @brief Initializes worker threads and their arguments.
+ * @brief Raises the soft limit on open file descriptors to the hard limit.
  *
- * Allocates and initializes the necessary structures for each worker thread, including 
- * argument data, and starts the threads. Each worker is associated with a shared mutex 
- * and various synchronization primitives for managing results and queue entries.
- *
- * @param workers          Array of extended_Thread structures representing the workers.
- * @param nthreads         Number of worker threads to initialize.
- * @param active_threads   Atomic variable tracking the number of active threads.
- * @param results          Array for storing results from the worker threads.
- * @param sem_queue        Semaphore for controlling access to the queue.
- * @param queued_entries   Pointer to the queue of entries to be processed by workers.
- *
- * @note A reference to allocated arguments is stored in `workers[i].args`. 
- *       This memory must be managed appropriately by the caller to prevent memory leaks.
- * @note The shared mutex is allocated within this function at 'workers[i].args.shared_mutex'
- *       and should be destroyed by the caller once all worker threads have completed execution.
- */
-
-void worker_state_initialize(extended_Thread workers[], int nthreads, atomic_short* active_threads, atomic_long results[], sem_t* sem_queue, Queue* queued_entries );
-
-/**
- * @brief Initializes a queue with a list of paths.
- *
- * Populates the queue by pushing each string from the `path` array into the queue.
- *
- * @param q          Pointer to the Queue structure to initialize.
- * @param path       Array of strings to be pushed into the queue.
- * @param size       Number of elements in the path array.
- * @param sem_queue  Semaphore used to manage access to the queue.
- * 
- * @note    push_q posts to the semaphore sem_queue 
-*           dynamically initializing sem_queue
- *          
- */
-void queue_initialize(Queue* q, char* path[], int size, sem_t* sem_queue);
-
-/**
- * @brief Joins an array of worker threads, handles errors, and releases resources.
- *
- * This function waits for the specified worker threads to finish their execution, 
- * retrieves their return values. Status is assumed to be EXIT_SUCCESS on entry and
- * if an EXIT_FAILURE is detected it is assigned as status and no more checks are done. 
- * Associated resources are freed
- *
- * @param workers   Array of extended_Thread structures representing the worker threads.
- * @param nthreads  Number of worker threads to join.
- * @param status    Pointer to an integer where the exit status will be updated 
- *                  based on the return values of the worker threads. If any thread 
- *                  returns a non-success status, this will reflect that status.
- *
- * @note If a thread fails to join, the function prints an error message to stderr
- *       and terminates the program. The shared mutex is destroyed after all threads 
- *       are joined.
+ * Every directory with entries still waiting in the scheduler keeps its descriptor 
+ * open, so wide trees need more descriptors than the default soft limit allows. 
+ * Failure to raise the limit is not an error.
  */
-
-void worker_join(extended_Thread workers[], int nthreads, int* status);
+void raise_fd_limit(void);
 
 /**
  * @brief Extracts a slice of strings from the input array.
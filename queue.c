@@ -20,7 +20,8 @@ Queue* create_q(void)
 
 void destroy_q(Queue *header)
 {
-    while(pop_q(header, NULL) != NULL);
+    Entry* e;
+    while((e = pop_entry_q(header)) != NULL) destroy_entry(NULL, e);
     if(header != NULL){
         pthread_mutex_destroy(&header->mutex);
         free(header);
@@ -28,16 +29,50 @@ void destroy_q(Queue *header)
     header = NULL;
 }
 
-void push_q(Queue *header, char* entry, sem_t* sem, int index_working_size)
+Entry* create_entry(Slab* slab, DirRef* parent, const char* name, int index_working_size)
 {
-    Entry *e = malloc(sizeof(Entry));
-    if(e == NULL){
-        destroy_q(header);
+    Entry *e = slab == NULL ? slab_alloc_unowned(sizeof(Entry)) : slab_alloc(slab);
+
+    e->index_working_size = index_working_size;
+    e->hint = 0;
+    e->name = parent == NULL ? strdup(name) : arena_strdup(&parent->names, name);
+    e->next = NULL;
+    if(e->name == NULL){
+        perror("strdup");
         exit(EXIT_FAILURE);
     }
+    e->parent = parent;
+    acquire_dirref(parent);
+    return e;
+}
 
+Entry* create_resume_entry(Slab* slab, DirRef* dir, int index_working_size)
+{
+    Entry *e = slab_alloc(slab);
     e->index_working_size = index_working_size;
-    e->path = strdup(entry);
+    e->hint = 0;
+    e->name = NULL;
+    e->next = NULL;
+    e->parent = dir;
+    acquire_dirref(dir);
+    return e;
+}
+
+void destroy_entry(Slab* slab, Entry* e)
+{
+    if(e == NULL) return;
+    if(e->parent == NULL) free(e->name);
+    release_dirref(e->parent);
+    slab_free(slab, e);
+}
+
+void push_q(Queue *header, char* entry, sem_t* sem, int index_working_size)
+{
+    push_entry_q(header, create_entry(NULL, NULL, entry, index_working_size), sem);
+}
+
+void push_entry_q(Queue *header, Entry* e, sem_t* sem)
+{
     e->next = NULL;
 
     pthread_mutex_lock(&header->mutex);
@@ -52,29 +87,67 @@ void push_q(Queue *header, char* entry, sem_t* sem, int index_working_size)
         previous_tail->next = e;
         header->tail = e;
     }
-    sem_post(sem);
+    if(sem != NULL) sem_post(sem);
     pthread_mutex_unlock(&header->mutex);
 }
 
-char* pop_q(Queue *header, int* index_working_size)
+void push_chain_q(Queue *header, Entry* head, Entry* tail, sem_t* sem, int n)
+{
+    tail->next = NULL;
+
+    pthread_mutex_lock(&header->mutex);
+    if (header->head == NULL) header->head = head;
+    else header->tail->next = head;
+    header->tail = tail;
+    if(sem != NULL){
+        for(int i = 0; i < n; i++) sem_post(sem);
+    }
+    pthread_mutex_unlock(&header->mutex);
+}
+
+Entry* pop_chain_q(Queue *header, int max, int* n)
 {
     pthread_mutex_lock(&header->mutex);
     Entry *head = header->head;
-    if(index_working_size != NULL && head != NULL){
-        *index_working_size = head -> index_working_size;  
+    Entry *last = NULL;
+    int taken = 0;
+    for(Entry* e = head; e != NULL && taken < max; e = e->next){
+        last = e;
+        taken++;
     }
-    if(head == NULL){
-        pthread_mutex_unlock(&header->mutex);
-        return NULL;
+    if(last != NULL){
+        header->head = last->next;
+        last->next = NULL;
     }
-    else{
-        header -> head = head -> next;
-        char* d = head -> path;
+    pthread_mutex_unlock(&header->mutex);
+    *n = taken;
+    return head;
+}
+
+char* pop_q(Queue *header, int* index_working_size)
+{
+    Entry *head = pop_entry_q(header);
+    if(head == NULL) return NULL;
+
+    if(index_working_size != NULL){
+        *index_working_size = head -> index_working_size;  
+    }
+    char* d = head -> name;
+    release_dirref(head -> parent);
+    slab_free(NULL, head);
+    return d;
+}
 
-        free(head);
-        pthread_mutex_unlock(&header->mutex);
-        return d;
+Entry* pop_entry_q(Queue *header)
+{
+    pthread_mutex_lock(&header->mutex);
+    Entry *head = header->head;
+    if(head != NULL){
+        header -> head = head -> next;
+        head -> next = NULL;
     }
+    pthread_mutex_unlock(&header->mutex);
+    return head;
 }
 
 int is_queue_empty(Queue* header){
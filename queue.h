@@ -22,11 +22,24 @@
 #include <semaphore.h>
 #include <string.h>
 #include <stdatomic.h>
+#include "dirref.h"
+#include "slab.h"
 
+/**
+ * @note `name` is relative to `parent`, entries without a parent hold a path as 
+ *       given on the command line. The name of an entry with a parent lives in 
+ *       the parent's name arena, the path of one without is allocated separately.
+ * @note An entry with a `NULL` name resumes the paused listing of `parent`, see 
+ *       `create_resume_entry`.
+ * @note `hint` is the number of entries expected below the entry, 0 if unknown, 
+ *       see hints.h. It fills the padding after `index_working_size`.
+ */
 typedef struct Entry {
     struct Entry *next;
     int index_working_size;
-    char* path;
+    int hint;
+    DirRef* parent;
+    char* name;
 } Entry;
 
 typedef struct Queue {
@@ -65,8 +78,8 @@ void destroy_q(Queue *header);
 /**
  * @brief Adds a new entry to the end of the queue.
  *
- * This function creates a new `Entry` from the provided string and adds it to the 
- * end of the queue. It ensures thread safety by locking the queue's mutex during 
+ * This function creates a new `Entry` without a parent directory from the provided 
+ * string and adds it to the end of the queue. It ensures thread safety by locking the queue's mutex during 
  * the operation. If memory allocation for the new entry fails, the function 
  * destroys the queue and terminates the program.
  *
@@ -74,7 +87,7 @@ void destroy_q(Queue *header);
  * @param entry            The string to be added to the queue. This string will be 
  *                        duplicated and stored in the new entry.
  * @param sem              Pointer to the semaphore used to signal that a new entry 
- *                        has been added to the queue.
+ *                        has been added to the queue, `NULL` if no signal is wanted.
  * @param index_working_size The index associated with the entry, used for tracking 
  *                           purposes within the queue.
  *
@@ -84,6 +97,42 @@ void destroy_q(Queue *header);
  */
 void push_q(Queue *header, char* entry, sem_t* sem, int index_working_size);
 
+/**
+ * @brief Adds an already allocated entry to the end of the queue.
+ *
+ * Same as `push_q` but takes ownership of an `Entry` created with `create_entry`,
+ * which lets entries move between the queue and the per-worker deques without
+ * being copied.
+ *
+ * @param header    Pointer to the `Queue` where the entry will be added.
+ * @param e         The entry to append, its `next` pointer is overwritten.
+ * @param sem       Semaphore posted once the entry is linked, may be `NULL`.
+ */
+void push_entry_q(Queue *header, Entry* e, sem_t* sem);
+
+/**
+ * @brief Appends a chain of entries to the queue in one critical section.
+ *
+ * @param header    Pointer to the `Queue` where the entries will be added.
+ * @param head      First entry of the chain, linked through `next`.
+ * @param tail      Last entry of the chain, its `next` pointer is overwritten.
+ * @param sem       Semaphore posted once per entry, may be `NULL`.
+ * @param n         Number of entries in the chain.
+ */
+void push_chain_q(Queue *header, Entry* head, Entry* tail, sem_t* sem, int n);
+
+/**
+ * @brief Removes up to `max` entries from the front of the queue in one critical section.
+ *
+ * @param header    Pointer to the `Queue` from which to pop the entries.
+ * @param max       Maximum number of entries to take, at least 1.
+ * @param n         Set to the number of entries taken.
+ *
+ * @return The first entry of the taken chain, linked through `next` and ended 
+ *         by `NULL`, or `NULL` if the queue is empty.
+ */
+Entry* pop_chain_q(Queue *header, int max, int* n);
+
 /**
  * @brief Removes and returns the entry at the front of the queue.
  *
@@ -104,6 +153,59 @@ void push_q(Queue *header, char* entry, sem_t* sem, int index_working_size);
  */
 char* pop_q(Queue *header, int* index_working_size);
 
+/**
+ * @brief Removes and returns the entry at the front of the queue.
+ *
+ * @param header    Pointer to the `Queue` from which to pop the entry.
+ *
+ * @return The unlinked entry or `NULL` if the queue is empty. 
+ *         The caller owns the entry and releases it with `destroy_entry`.
+ */
+Entry* pop_entry_q(Queue *header);
+
+/**
+ * @brief Allocates a queue entry for `name` inside `parent`.
+ *
+ * The entry becomes a user of `parent`, keeping its descriptor open until the 
+ * entry is destroyed. The entry comes from the caller's slab and its name is 
+ * copied into the arena of `parent`, so no `malloc` is made per entry once the 
+ * slab and arena are warm.
+ *
+ * @param slab                  The calling worker's slab, `NULL` allocates with `malloc`.
+ * @param parent                The directory the entry was found in, may be `NULL`.
+ * @param name                  The name to store, duplicated into the entry.
+ * @param index_working_size    Index of the result the entry contributes to.
+ *
+ * @return The new entry. Terminates the program if allocation fails.
+ *
+ * @note Only the worker listing `parent` creates entries with it, the arena is 
+ *       not locked.
+ */
+Entry* create_entry(Slab* slab, DirRef* parent, const char* name, int index_working_size);
+
+/**
+ * @brief Allocates an entry that resumes listing a directory.
+ *
+ * The entry becomes a user of `dir`, keeping its descriptor, and with it the 
+ * position reached in the listing, open until the entry is destroyed.
+ *
+ * @param slab                  The calling worker's slab.
+ * @param dir                   The directory whose listing was paused.
+ * @param index_working_size    Index of the result the directory contributes to.
+ *
+ * @return The new entry. Terminates the program if allocation fails.
+ */
+Entry* create_resume_entry(Slab* slab, DirRef* dir, int index_working_size);
+
+/**
+ * @brief Frees an entry and the name it owns and releases its parent directory.
+ *
+ * @param slab  The calling worker's slab, may be `NULL`. Entries from another 
+ *              worker's slab are handed back to it.
+ * @param e     The entry to free, may be `NULL`.
+ */
+void destroy_entry(Slab* slab, Entry* e);
+
 /**
  * @brief Checks if the queue is empty.
  *
@@ -0,0 +1,454 @@
+#include "scheduler.h"
+static SchedPool* create_pool(int nworkers, int limit){
+    SchedPool* p = aligned_alloc(64, sizeof(SchedPool));
+    if(p == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    p->deques = aligned_alloc(64, nworkers * sizeof(WorkDeque));
+    if(p->deques == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < nworkers; i++) init_deque(&p->deques[i]);
+
+    p->dev      = 0;
+    p->keyed    = false;
+    p->limit    = limit < 1 ? 1 : limit;
+    p->injected = create_q();
+    pthread_mutex_init(&p->prio_lock, NULL);
+    p->prio     = NULL;
+    p->prio_cap = 0;
+    atomic_init(&p->nprio, 0);
+    atomic_init(&p->pending, 0);
+    atomic_init(&p->attached, 0);
+    atomic_init(&p->idle, 0);
+    atomic_init(&p->epoch, 0);
+    return p;
+}
+
+static void destroy_pool(SchedPool* p, int nworkers){
+    for(int i = 0; i < nworkers; i++) destroy_deque(&p->deques[i]);
+    free(p->deques);
+    destroy_q(p->injected);
+    int nprio = atomic_load(&p->nprio);
+    for(int i = 0; i < nprio; i++) destroy_entry(NULL, p->prio[i]);
+    free(p->prio);
+    pthread_mutex_destroy(&p->prio_lock);
+    free(p);
+}
+
+Scheduler* create_sched(int nworkers){
+    Scheduler* s = malloc(sizeof(Scheduler));
+    if(s == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    s->slots = aligned_alloc(64, nworkers * sizeof(SchedSlot));
+    if(s->slots == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    for(int i = 0; i < nworkers; i++){
+        s->slots[i].seed = 2654435761u * (i + 1);
+        s->slots[i].pool = NULL;
+        s->slots[i].nbatch = 0;
+        atomic_init(&s->slots[i].completed, 0);
+        atomic_init(&s->slots[i].queued_bytes, 0);
+        init_stats(&s->slots[i].stats);
+    }
+
+    s->nodes = calloc(nworkers, sizeof(int));
+    if(s->nodes == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    s->nworkers = nworkers;
+    s->pools = malloc(sizeof(SchedPool*));
+    if(s->pools == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    s->pools[0] = create_pool(nworkers, nworkers);
+    s->npools = 1;
+    atomic_init(&s->active, nworkers);
+    atomic_init(&s->throttle, 0);
+    return s;
+}
+
+void destroy_sched(Scheduler* s){
+    if(s == NULL) return;
+    for(int i = 0; i < s->nworkers; i++) destroy_stats(&s->slots[i].stats);
+    for(int i = 0; i < s->npools; i++) destroy_pool(s->pools[i], s->nworkers);
+    free(s->pools);
+    free(s->nodes);
+    free(s->slots);
+    free(s);
+}
+
+int sched_device_pool(Scheduler* s, dev_t dev, int limit){
+    for(int i = 0; i < s->npools; i++){
+        if(s->pools[i]->keyed && s->pools[i]->dev == dev) return i;
+    }
+
+    SchedPool* p = s->pools[0];
+    if(p->keyed){
+        SchedPool** pools = realloc(s->pools, (s->npools + 1) * sizeof(SchedPool*));
+        if(pools == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        s->pools = pools;
+        p = create_pool(s->nworkers, limit);
+        s->pools[s->npools++] = p;
+    }
+    p->dev   = dev;
+    p->keyed = true;
+    p->limit = limit < 1 ? 1 : limit;
+    return p == s->pools[0] ? 0 : s->npools - 1;
+}
+
+void sched_set_node(Scheduler* s, int worker, int node){
+    s->nodes[worker] = node;
+}
+
+dev_t sched_device(Scheduler* s, int worker){
+    return s->slots[worker].pool->dev;
+}
+
+static void futex_wait(atomic_uint* word, unsigned int expected){
+    syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(atomic_uint* word, int n){
+    syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
+
+static bool wake(SchedPool* p, int n){
+    //Pairs with the idle announcement in sched_next, either the pusher sees the
+    //idle worker or the idle worker sees the pushed entry.
+    atomic_thread_fence(memory_order_seq_cst);
+    int idle = atomic_load_explicit(&p->idle, memory_order_relaxed);
+    if(idle == 0) return false;
+    atomic_fetch_add(&p->epoch, 1);
+    futex_wake(&p->epoch, n < idle ? n : idle);
+    return true;
+}
+
+void sched_inject(Scheduler* s, int pool, Entry* e){
+    SchedPool* p = s->pools[pool];
+    atomic_fetch_add(&p->pending, 1);
+    push_entry_q(p->injected, e, NULL);
+    wake(p, 1);
+}
+
+void sched_inject_batch(Scheduler* s, int pool, Entry* entries[], int n){
+    if(n == 0) return;
+    SchedPool* p = s->pools[pool];
+    for(int i = 0; i + 1 < n; i++) entries[i]->next = entries[i + 1];
+    atomic_fetch_add(&p->pending, n);
+    push_chain_q(p->injected, entries[0], entries[n - 1], NULL, n);
+    wake(p, n);
+}
+
+void sched_defer(Scheduler* s, int worker, Entry* e){
+    SchedPool* p = s->slots[worker].pool;
+    e->next = NULL;
+    atomic_fetch_add(&p->pending, 1);
+    push_chain_q(p->injected, e, e, NULL, 1);
+    wake(p, 1);
+}
+
+//Called with the lock held.
+static void sift_down(Entry** heap, int n, int i){
+    while(1){
+        int largest = i;
+        int l = 2 * i + 1;
+        int r = l + 1;
+        if(l < n && heap[l]->hint > heap[largest]->hint) largest = l;
+        if(r < n && heap[r]->hint > heap[largest]->hint) largest = r;
+        if(largest == i) return;
+        Entry* tmp      = heap[i];
+        heap[i]         = heap[largest];
+        heap[largest]   = tmp;
+        i = largest;
+    }
+}
+
+static void push_prio(SchedPool* p, Entry* e){
+    atomic_fetch_add(&p->pending, 1);
+    pthread_mutex_lock(&p->prio_lock);
+    int n = atomic_load_explicit(&p->nprio, memory_order_relaxed);
+    if(n == p->prio_cap){
+        p->prio_cap = p->prio_cap == 0 ? 16 : p->prio_cap * 2;
+        Entry** prio = realloc(p->prio, p->prio_cap * sizeof(Entry*));
+        if(prio == NULL){
+            perror("realloc");
+            exit(EXIT_FAILURE);
+        }
+        p->prio = prio;
+    }
+    int i = n;
+    for(; i > 0 && p->prio[(i - 1) / 2]->hint < e->hint; i = (i - 1) / 2) p->prio[i] = p->prio[(i - 1) / 2];
+    p->prio[i] = e;
+    atomic_store_explicit(&p->nprio, n + 1, memory_order_relaxed);
+    pthread_mutex_unlock(&p->prio_lock);
+    wake(p, 1);
+}
+
+static Entry* pop_prio(SchedPool* p){
+    //Ordered after the idle announcement in sched_next, pairing with the fence in
+    //wake, so an entry pushed while this worker parks is either seen or wakes it.
+    if(atomic_load_explicit(&p->nprio, memory_order_seq_cst) == 0) return NULL;
+    Entry* e = NULL;
+    pthread_mutex_lock(&p->prio_lock);
+    int n = atomic_load_explicit(&p->nprio, memory_order_relaxed);
+    if(n > 0){
+        e = p->prio[0];
+        p->prio[0] = p->prio[n - 1];
+        sift_down(p->prio, n - 1, 0);
+        atomic_store_explicit(&p->nprio, n - 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&p->prio_lock);
+    return e;
+}
+
+void sched_push(Scheduler* s, int worker, Entry* e){
+    SchedSlot* slot = &s->slots[worker];
+    if(e->hint > 0){
+        push_prio(slot->pool, e);
+        return;
+    }
+    slot->batch[slot->nbatch++] = e;
+    if(slot->nbatch == SCHED_BATCH) sched_flush(s, worker);
+}
+
+void sched_flush(Scheduler* s, int worker){
+    SchedSlot* slot = &s->slots[worker];
+    int n = slot->nbatch;
+    if(n == 0) return;
+    slot->nbatch = 0;
+    SchedPool* p = slot->pool;
+    atomic_fetch_add_explicit(&p->pending, n, memory_order_relaxed);
+    deque_push_batch(&p->deques[worker], slot->batch, n);
+    if(wake(p, n)) STATS_INC(slot->stats.wakeups);
+}
+
+static unsigned int next_victim(SchedSlot* slot, int nworkers){
+    //xorshift, only used to spread thieves over the victims.
+    unsigned int x = slot->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    slot->seed = x;
+    return x % nworkers;
+}
+
+static Entry* find_work(Scheduler* s, int worker, SchedPool* p){
+    SchedSlot* slot = &s->slots[worker];
+    Entry* e = pop_prio(p);
+    if(e != NULL) return e;
+    e = deque_pop(&p->deques[worker]);
+    if(e != NULL) return e;
+
+    int n;
+    STATS_CLOCK(start);
+    e = pop_chain_q(p->injected, SCHED_BATCH, &n);
+    STATS_SINCE(slot->stats.queue_wait_ns, start);
+    if(e != NULL){
+        //Entries taken beyond the first stay counted in pending, so they only move.
+        Entry* rest[SCHED_BATCH];
+        int nrest = 0;
+        for(Entry* r = e->next; r != NULL; r = r->next) rest[nrest++] = r;
+        e->next = NULL;
+        if(nrest > 0){
+            deque_push_batch(&p->deques[worker], rest, nrest);
+            if(wake(p, nrest)) STATS_INC(slot->stats.wakeups);
+        }
+        return e;
+    }
+
+    //Workers on the own node first, the second round only visits the others.
+    int contended;
+    do {
+        contended = 0;
+        int first = next_victim(slot, s->nworkers);
+        for(int remote = 0; remote < 2; remote++){
+            for(int i = 0; i < s->nworkers; i++){
+                int victim = (first + i) % s->nworkers;
+                if(victim == worker || (s->nodes[victim] != s->nodes[worker]) != remote) continue;
+
+                int lost;
+                e = deque_steal(&p->deques[victim], &lost);
+                if(e != NULL){
+                    STATS_INC(slot->stats.steals);
+                    return e;
+                }
+                contended |= lost;
+            }
+            if(contended) break;
+        }
+    } while(contended);
+    return NULL;
+}
+
+static SchedPool* attach(Scheduler* s, int worker){
+    while(1){
+        int best = -1;
+        int best_attached = INT_MAX;
+        for(int i = 0; i < s->npools; i++){
+            SchedPool* p = s->pools[i];
+            if(atomic_load_explicit(&p->pending, memory_order_acquire) == 0) continue;
+
+            int attached = atomic_load(&p->attached);
+            if(attached < p->limit && attached < best_attached){
+                best = i;
+                best_attached = attached;
+            }
+        }
+        if(best == -1) return NULL;
+
+        SchedPool* p = s->pools[best];
+        if(atomic_compare_exchange_strong(&p->attached, &best_attached, best_attached + 1)){
+            s->slots[worker].pool = p;
+            return p;
+        }
+    }
+}
+
+static bool has_work(Scheduler* s){
+    for(int i = 0; i < s->npools; i++){
+        if(atomic_load(&s->pools[i]->pending) > 0) return true;
+    }
+    return false;
+}
+
+static void detach(Scheduler* s, SchedSlot* slot){
+    SchedPool* p = slot->pool;
+    if(p == NULL) return;
+    slot->pool = NULL;
+    atomic_fetch_sub(&p->attached, 1);
+    //Workers waiting for a pool at its limit to admit them.
+    if(atomic_load(&p->pending) > 0){
+        atomic_fetch_add(&s->throttle, 1);
+        futex_wake(&s->throttle, INT_MAX);
+    }
+}
+
+Entry* sched_next(Scheduler* s, int worker){
+    SchedSlot* slot = &s->slots[worker];
+    SchedPool* p = slot->pool;
+    if(p != NULL){
+        sched_flush(s, worker);
+        if(worker < atomic_load_explicit(&s->active, memory_order_relaxed)){
+            Entry* e = deque_pop(&p->deques[worker]);
+            if(e != NULL) return e;
+        }
+    }
+
+    while(1){
+        if(worker >= atomic_load(&s->active)){
+            //Throttled, same eventcount protocol as idle parking on `throttle`.
+            //A wakeup meant for this worker is passed on to an idle one of its pool.
+            if((p = slot->pool) != NULL){
+                detach(s, slot);
+                wake(p, 1);
+            }
+            unsigned int key = atomic_load(&s->throttle);
+            if(worker < atomic_load(&s->active)) continue;
+            if(!has_work(s)) return NULL;
+            futex_wait(&s->throttle, key);
+            continue;
+        }
+
+        //No entry can appear in a pool once its counter reached zero.
+        p = slot->pool;
+        if(p == NULL || atomic_load_explicit(&p->pending, memory_order_acquire) == 0){
+            detach(s, slot);
+            //Returning would free this worker's entries still queued in a pool it left.
+            unsigned int key = atomic_load(&s->throttle);
+            if((p = attach(s, worker)) == NULL){
+                if(!has_work(s)) return NULL;
+                futex_wait(&s->throttle, key);
+                continue;
+            }
+        }
+
+        Entry* e = find_work(s, worker, p);
+        if(e != NULL) return e;
+
+        //Take the epoch, announce idleness, then look once more before parking.
+        unsigned int key = atomic_load(&p->epoch);
+        atomic_fetch_add(&p->idle, 1);
+        e = find_work(s, worker, p);
+        if(e != NULL || atomic_load(&p->pending) == 0){
+            atomic_fetch_sub(&p->idle, 1);
+            if(e != NULL) return e;
+            continue;
+        }
+
+        STATS_INC(slot->stats.parks);
+        STATS_CLOCK(start);
+        futex_wait(&p->epoch, key);
+        STATS_SINCE(slot->stats.idle_ns, start);
+        atomic_fetch_sub(&p->idle, 1);
+    }
+}
+
+Entry* sched_try_next(Scheduler* s, int worker){
+    SchedSlot* slot = &s->slots[worker];
+    SchedPool* p = slot->pool;
+    if(p == NULL) return NULL;
+    sched_flush(s, worker);
+    if(worker >= atomic_load_explicit(&s->active, memory_order_relaxed)) return NULL;
+    if(atomic_load_explicit(&p->pending, memory_order_acquire) == 0) return NULL;
+    return find_work(s, worker, p);
+}
+
+void sched_set_active(Scheduler* s, int n){
+    if(n > s->nworkers) n = s->nworkers;
+    if(n < 1) n = 1;
+    int old = atomic_exchange(&s->active, n);
+    if(n > old){
+        atomic_fetch_add(&s->throttle, 1);
+        futex_wake(&s->throttle, INT_MAX);
+    }
+}
+
+long sched_completed(Scheduler* s){
+    long total = 0;
+    for(int i = 0; i < s->nworkers; i++) total += atomic_load_explicit(&s->slots[i].completed, memory_order_relaxed);
+    return total;
+}
+
+long sched_queued_bytes(Scheduler* s){
+    long total = 0;
+    for(int i = 0; i < s->nworkers; i++) total += atomic_load_explicit(&s->slots[i].queued_bytes, memory_order_relaxed);
+    return total;
+}
+
+int sched_idle(Scheduler* s){
+    int idle = 0;
+    for(int i = 0; i < s->npools; i++) idle += atomic_load_explicit(&s->pools[i]->idle, memory_order_relaxed);
+    return idle;
+}
+
+WorkerStats* sched_stats(Scheduler* s, int worker){
+    return &s->slots[worker].stats;
+}
+
+void sched_done(Scheduler* s, int worker){
+    SchedSlot* slot = &s->slots[worker];
+    SchedPool* p = slot->pool;
+    //Only the owner writes its count, the controller reads it without a lock.
+    atomic_store_explicit(&slot->completed, atomic_load_explicit(&slot->completed, memory_order_relaxed) + 1, memory_order_relaxed);
+    if(atomic_fetch_sub(&p->pending, 1) == 1){
+        atomic_fetch_add(&p->epoch, 1);
+        futex_wake(&p->epoch, INT_MAX);
+        //Throttled workers return once every pool is done.
+        atomic_fetch_add(&s->throttle, 1);
+        futex_wake(&s->throttle, INT_MAX);
+    }
+}
@@ -0,0 +1,368 @@
+/**
+ *
+ * This file defines the work-stealing scheduler that hands entries to the workers.
+ * Every worker owns a `WorkDeque`, entries discovered by a worker are pushed onto
+ * its own deque and popped again in LIFO order, so the common path takes no lock.
+ * A worker that runs out of work first drains the shared injection `Queue`, which
+ * holds the paths given on the command line, then tries to steal from the other
+ * workers' deques before going idle.
+ *
+ * Termination is detected through a counter of outstanding entries, incremented
+ * when an entry is scheduled and decremented once it has been fully processed
+ * (including pushing any children). When it reaches zero no more work can appear
+ * and every worker is released.
+ *
+ * Idle workers park on a futex used as an eventcount. A worker reads `epoch`,
+ * announces itself in `idle`, looks for work once more and only then waits for
+ * `epoch` to change. Publishing work bumps `epoch` and wakes at most one parked
+ * worker per entry, and only if `idle` shows that someone is parked, so the common
+ * case costs no system call. A wakeup racing with a worker going to sleep changes
+ * `epoch` first, which makes the wait return at once instead of being lost.
+ * Parked workers take no CPU time, and finishing the last entry wakes all of them.
+ *
+ * Entries are scheduled in batches. `sched_push` only collects entries in the
+ * worker's slot, `sched_flush` publishes them on the deque with one update of the
+ * counter, and wakes as many idle workers as there are entries but no more. A
+ * worker taking from the injection queue takes a batch too, keeps one entry and
+ * puts the rest on its own deque where others can steal them.
+ *
+ * Work is split into pools, one per device of the command line paths, so roots on
+ * a slow file system do not hold workers that could be scanning a fast one. Every
+ * pool has its own injection queue, its own deque per worker, its own counter of
+ * outstanding entries and its own eventcount, and admits at most `limit` workers.
+ * A worker attaches to the unfinished pool with the fewest workers and only takes,
+ * steals and pushes entries of that pool. Once the pool's counter reaches zero its
+ * workers detach and move on to another pool with room. A worker that finds every
+ * pool with work at its limit parks on the second eventcount below until one
+ * admits it, and only returns once no pool has work left, so entries allocated by
+ * a worker never outlive it on the deques of a pool it left. Directories on other
+ * devices below a root stay in the root's pool.
+ *
+ * The number of workers allowed to take entries can be lowered at run time with 
+ * `sched_set_active`. Workers with an index at or above it finish what they hold, 
+ * leave their pool and park on a second eventcount until they are let back in or 
+ * every pool is done. Entries left on their deques are stolen by the others.
+ *
+ * Entries with a `hint`, directories a previous scan found to hold many entries, 
+ * skip the deques. They go to the pool's priority heap, largest hint first, which 
+ * every worker of the pool looks at before its own deque. Expensive subtrees are 
+ * thereby started as soon as they are found, and split over the workers by 
+ * stealing while the rest of the tree is still being walked, see hints.h. Without 
+ * hints the heap stays empty and costs one relaxed load per entry taken.
+ *
+ * Every worker belongs to a NUMA node, all to node 0 unless the workers are placed 
+ * with `--numa` or `--cpus`, see topology.h. A worker looking for entries to steal 
+ * tries every worker on its own node before any other, so entries, and the 
+ * directories they point into, move between nodes only when a whole node ran dry.
+ *
+ * Every slot also holds the worker's instrumentation counters and a count of the 
+ * entries it completed, read by the controller of `-j auto`, see tuner.h.
+ *
+ * @file scheduler.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Work-stealing scheduler built on per-worker deques.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "queue.h"
+#include "deque.h"
+#include "stats.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SCHED_BATCH 64
+
+struct SchedPool;
+
+/**
+ * @note `pool` is the pool the worker is attached to, `NULL` if none. It is only 
+ *       written by the worker itself.
+ * @note `queued_bytes` is the worker's share of `sched_queued_bytes`, negative 
+ *       when it took more entries than it scheduled.
+ */
+typedef struct {
+    _Alignas(64) unsigned int seed;
+    struct SchedPool* pool;
+    int nbatch;
+    atomic_long completed;
+    atomic_long queued_bytes;
+    Entry* batch[SCHED_BATCH];
+    WorkerStats stats;
+} SchedSlot;
+
+/**
+ * @note `keyed` is false for the pool created by `create_sched` until a device is
+ *       assigned to it by `sched_device_pool`.
+ * @note `prio` is a max-heap of `nprio` entries by `hint`, guarded by `prio_lock`. 
+ *       `nprio` is also read without the lock to skip an empty heap.
+ */
+typedef struct SchedPool {
+    dev_t dev;
+    bool keyed;
+    int limit;
+    WorkDeque* deques;
+    Queue* injected;
+    pthread_mutex_t prio_lock;
+    Entry** prio;
+    int prio_cap;
+    _Alignas(64) atomic_int nprio;
+    _Alignas(64) atomic_long pending;
+    _Alignas(64) atomic_int attached;
+    _Alignas(64) atomic_int idle;
+    _Alignas(64) atomic_uint epoch;
+} SchedPool;
+
+/**
+ * @note `nodes` holds the NUMA node of every worker, set by `sched_set_node` and 
+ *       only read once the workers run.
+ */
+typedef struct Scheduler {
+    SchedSlot* slots;
+    int* nodes;
+    int nworkers;
+    SchedPool** pools;
+    int npools;
+    _Alignas(64) atomic_int active;
+    atomic_uint throttle;
+} Scheduler;
+
+/**
+ * @brief Creates a scheduler with a single pool open to every worker.
+ *
+ * @param nworkers Number of workers that will call `sched_next`.
+ *
+ * @return A pointer to the new scheduler. Terminates the program on failure.
+ *
+ * @note Release the scheduler with `destroy_sched` once every worker is joined.
+ */
+Scheduler* create_sched(int nworkers);
+
+/**
+ * @brief Frees the scheduler, its pools and any entries left in them.
+ *
+ * @param s Pointer to the scheduler.
+ */
+void destroy_sched(Scheduler* s);
+
+/**
+ * @brief Returns the pool of a device, adding it if needed.
+ *
+ * The first device is assigned to the pool created by `create_sched`, every other 
+ * device gets a new pool.
+ *
+ * @param s     Pointer to the scheduler.
+ * @param dev   The device.
+ * @param limit Most workers attached to the pool at once, used when the pool is 
+ *              added.
+ *
+ * @return The index of the pool.
+ *
+ * @note Must be called before the workers are started.
+ */
+int sched_device_pool(Scheduler* s, dev_t dev, int limit);
+
+/**
+ * @brief Sets the NUMA node a worker runs on, 0 by default.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the worker.
+ * @param node      The node.
+ *
+ * @note Must be called before the workers are started.
+ */
+void sched_set_node(Scheduler* s, int worker, int node);
+
+/**
+ * @brief Returns the device of the pool a worker is attached to.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the worker, which holds an entry of the pool.
+ *
+ * @return The device given to `sched_device_pool`, 0 for an unkeyed pool.
+ */
+dev_t sched_device(Scheduler* s, int worker);
+
+/**
+ * @brief Schedules an entry from outside the worker pool.
+ *
+ * The entry is placed on the pool's injection queue, from which any worker 
+ * attached to the pool may take it.
+ *
+ * @param s     Pointer to the scheduler.
+ * @param pool  Index of the pool, 0 for a scheduler without devices.
+ * @param e     The entry to schedule.
+ */
+void sched_inject(Scheduler* s, int pool, Entry* e);
+
+/**
+ * @brief Schedules several entries from outside the worker pool.
+ *
+ * The entries are linked and appended to the pool's injection queue in one 
+ * critical section.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param pool      Index of the pool.
+ * @param entries   The entries to schedule.
+ * @param n         Number of entries.
+ */
+void sched_inject_batch(Scheduler* s, int pool, Entry* entries[], int n);
+
+/**
+ * @brief Schedules an entry discovered by a worker.
+ *
+ * The entry belongs to the worker's pool. It is added to the worker's batch, which is flushed once it holds 
+ * `SCHED_BATCH` entries. An entry with a `hint` is published on the pool's 
+ * priority heap right away instead.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the calling worker.
+ * @param e         The entry to schedule.
+ *
+ * @note The worker calls `sched_flush` once it has scheduled the children of an 
+ *       entry, before `sched_done` for it.
+ */
+void sched_push(Scheduler* s, int worker, Entry* e);
+
+/**
+ * @brief Publishes the entries collected by `sched_push`.
+ *
+ * The batch is pushed onto the worker's own deque in its pool at once and up to 
+ * one idle worker of the pool per entry is woken.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the calling worker.
+ */
+void sched_flush(Scheduler* s, int worker);
+
+/**
+ * @brief Returns the next entry for a worker, blocking while none is available.
+ *
+ * Flushes the worker's batch, then looks at the pool's priority heap, then the worker's own deque, then the 
+ * pool's injection queue, then tries to steal from the other workers of the pool, 
+ * those on the worker's node first. 
+ * If nothing is found the worker parks until new work is published or the pool 
+ * finishes. A worker without a pool, or whose pool finished, attaches to another 
+ * one first, waiting while every pool with work is at its limit.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the calling worker.
+ *
+ * @return The entry to process, or `NULL` once no pool has work left.
+ *
+ * @note Every returned entry must be followed by a call to `sched_done`.
+ * @note All initial entries must be injected before the first call, otherwise
+ *       a worker may observe no outstanding work and return early.
+ */
+Entry* sched_next(Scheduler* s, int worker);
+
+/**
+ * @brief Returns the next entry for a worker without blocking.
+ *
+ * Same search as `sched_next`, for workers that have other work to get back to, 
+ * such as requests in flight on an io_uring ring. Never moves the worker to 
+ * another pool.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the calling worker.
+ *
+ * @return The entry to process, or `NULL` if none is available right now.
+ *
+ * @note Every returned entry must be followed by a call to `sched_done`.
+ */
+Entry* sched_try_next(Scheduler* s, int worker);
+
+/**
+ * @brief Sets how many workers may take entries.
+ *
+ * Workers `0` to `n - 1` take entries, the others park once they hold no entry. 
+ * Raising the number wakes the parked workers that are let back in.
+ *
+ * @param s Pointer to the scheduler.
+ * @param n Number of active workers, clamped to 1 and the number of workers.
+ */
+void sched_set_active(Scheduler* s, int n);
+
+/**
+ * @brief Returns the number of entries completed by all workers so far.
+ *
+ * @param s Pointer to the scheduler.
+ *
+ * @return The sum of the workers' counts, each read without synchronization.
+ */
+long sched_completed(Scheduler* s);
+
+/**
+ * @brief Schedules an entry behind all work already scheduled in the worker's pool.
+ *
+ * The entry is added to the pool's injection queue, which workers only take from 
+ * once their own deque is empty.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the calling worker, attached to a pool.
+ * @param e         The entry to schedule.
+ */
+void sched_defer(Scheduler* s, int worker, Entry* e);
+
+/**
+ * @brief Adds to the memory held by the entries waiting in the scheduler.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the calling worker.
+ * @param bytes     Bytes of the entries scheduled, negative for entries taken.
+ */
+static inline void sched_count_bytes(Scheduler* s, int worker, long bytes){
+    atomic_long* queued = &s->slots[worker].queued_bytes;
+    atomic_store_explicit(queued, atomic_load_explicit(queued, memory_order_relaxed) + bytes, memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the memory held by the entries waiting in the scheduler.
+ *
+ * @param s Pointer to the scheduler.
+ *
+ * @return The sum of the bytes counted with `sched_count_bytes` by all workers, 
+ *         each read without synchronization.
+ */
+long sched_queued_bytes(Scheduler* s);
+
+/**
+ * @brief Returns the number of workers parked for lack of work.
+ *
+ * @param s Pointer to the scheduler.
+ *
+ * @return The number of idle workers over all pools, not counting throttled ones.
+ */
+int sched_idle(Scheduler* s);
+
+/**
+ * @brief Returns the instrumentation counters of a worker.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the worker.
+ *
+ * @return The counters in the worker's slot, valid until `destroy_sched`.
+ */
+WorkerStats* sched_stats(Scheduler* s, int worker);
+
+/**
+ * @brief Marks an entry returned by `sched_next` or `sched_try_next` as fully processed.
+ *
+ * Must be called after any children of the entry have been scheduled. The call
+ * retiring the last outstanding entry of a pool releases all of its waiting workers.
+ *
+ * @param s         Pointer to the scheduler.
+ * @param worker    Index of the worker the entry was returned to.
+ */
+void sched_done(Scheduler* s, int worker);
+
+#endif
@@ -0,0 +1,119 @@
+#include "slab.h"
+
+void init_slab(Slab* slab, size_t size){
+    //Objects start right after their header and stay 16 byte aligned.
+    slab->object_size = (sizeof(SlabObject) + size + 15) & ~(size_t)15;
+    slab->chunk_objects = SLAB_CHUNK_SIZE / slab->object_size;
+    if(slab->chunk_objects < 16) slab->chunk_objects = 16;
+    slab->free   = NULL;
+    slab->chunks = NULL;
+    atomic_init(&slab->remote, NULL);
+}
+
+void destroy_slab(Slab* slab){
+    SlabChunk* chunk = slab->chunks;
+    while(chunk != NULL){
+        SlabChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    slab->free   = NULL;
+    slab->chunks = NULL;
+    atomic_store(&slab->remote, NULL);
+}
+
+static void grow_slab(Slab* slab){
+    SlabChunk* chunk = malloc(sizeof(SlabChunk) + slab->chunk_objects * slab->object_size);
+    if(chunk == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    chunk->next  = slab->chunks;
+    slab->chunks = chunk;
+
+    for(size_t i = slab->chunk_objects; i > 0; i--){
+        SlabObject* obj = (SlabObject*)(chunk->objects + (i - 1) * slab->object_size);
+        obj->owner = slab;
+        obj->next  = slab->free;
+        slab->free = obj;
+    }
+}
+
+void* slab_alloc(Slab* slab){
+    if(slab->free == NULL){
+        slab->free = atomic_exchange_explicit(&slab->remote, NULL, memory_order_acquire);
+        if(slab->free == NULL) grow_slab(slab);
+    }
+    SlabObject* obj = slab->free;
+    slab->free = obj->next;
+    return obj + 1;
+}
+
+void* slab_alloc_unowned(size_t size){
+    SlabObject* obj = malloc(sizeof(SlabObject) + size);
+    if(obj == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    obj->owner = NULL;
+    return obj + 1;
+}
+
+void slab_free(Slab* self, void* p){
+    SlabObject* obj = (SlabObject*)p - 1;
+    Slab* owner = obj->owner;
+    if(owner == NULL){
+        free(obj);
+        return;
+    }
+    if(owner == self){
+        obj->next  = self->free;
+        self->free = obj;
+        return;
+    }
+
+    //Only the owner takes from the remote stack and it always takes all of it, so there is no ABA.
+    SlabObject* head = atomic_load_explicit(&owner->remote, memory_order_relaxed);
+    do {
+        obj->next = head;
+    } while(!atomic_compare_exchange_weak_explicit(&owner->remote, &head, obj, memory_order_release, memory_order_relaxed));
+}
+
+void init_arena(NameArena* arena){
+    arena->head = NULL;
+}
+
+void destroy_arena(NameArena* arena){
+    NameBlock* block = arena->head;
+    while(block != NULL){
+        NameBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head = NULL;
+}
+
+char* arena_strdup(NameArena* arena, const char* name){
+    size_t len = strlen(name) + 1;
+    NameBlock* block = arena->head;
+    if(block == NULL || block->capacity - block->used < len){
+        size_t capacity = block == NULL ? ARENA_FIRST_BLOCK : block->capacity * 2;
+        if(capacity > ARENA_MAX_BLOCK) capacity = ARENA_MAX_BLOCK;
+        if(capacity < len) capacity = len;
+
+        block = malloc(sizeof(NameBlock) + capacity);
+        if(block == NULL){
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        block->next     = arena->head;
+        block->used     = 0;
+        block->capacity = capacity;
+        arena->head     = block;
+    }
+
+    char* copy = block->data + block->used;
+    memcpy(copy, name, len);
+    block->used += len;
+    return copy;
+}
@@ -0,0 +1,135 @@
+/**
+ *
+ * This file defines the two allocators used for the objects created once per
+ * directory entry, so that scanning a tree does not go through `malloc` for every
+ * file and subdirectory.
+ *
+ * `Slab` hands out fixed-size objects from chunks owned by one worker. Objects are
+ * allocated only by the owner but may be freed by any worker, since a stolen entry
+ * is retired by the thief. A worker freeing its own object puts it on the slab's
+ * free list, others push it onto the owner's `remote` stack, which the owner takes
+ * over in one exchange when its free list runs empty. Chunks are only returned when
+ * the slab is destroyed.
+ *
+ * `NameArena` is a bump allocator for names. Every directory owns one and the names
+ * of the entries scheduled from it are copied into it while it is listed. The
+ * arena is freed in bulk together with the directory handle, once the directory's
+ * subtree is complete and no entry refers to it anymore.
+ *
+ * @file slab.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Per-worker slab allocator and bump arena for names.
+ */
+
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#define SLAB_CHUNK_SIZE (64 * 1024)
+#define ARENA_FIRST_BLOCK 256
+#define ARENA_MAX_BLOCK (64 * 1024)
+
+typedef struct SlabObject {
+    struct Slab* owner;
+    struct SlabObject* next;
+} SlabObject;
+
+typedef struct SlabChunk {
+    struct SlabChunk* next;
+    _Alignas(16) char objects[];
+} SlabChunk;
+
+typedef struct Slab {
+    size_t object_size;
+    size_t chunk_objects;
+    SlabObject* free;
+    SlabChunk* chunks;
+    _Alignas(64) _Atomic(SlabObject*) remote;
+} Slab;
+
+typedef struct NameBlock {
+    struct NameBlock* next;
+    size_t used;
+    size_t capacity;
+    char data[];
+} NameBlock;
+
+typedef struct {
+    NameBlock* head;
+} NameArena;
+
+/**
+ * @brief Initializes an empty slab.
+ *
+ * @param slab  The slab.
+ * @param size  Size of the objects handed out.
+ */
+void init_slab(Slab* slab, size_t size);
+
+/**
+ * @brief Frees every chunk of the slab.
+ *
+ * @param slab The slab.
+ *
+ * @note No object of the slab may be in use or be freed afterwards.
+ */
+void destroy_slab(Slab* slab);
+
+/**
+ * @brief Allocates an object, only called by the slab's owner.
+ *
+ * @param slab The slab.
+ *
+ * @return The object. Terminates the program if allocation fails.
+ */
+void* slab_alloc(Slab* slab);
+
+/**
+ * @brief Allocates an object outside of any slab, for callers without one.
+ *
+ * @param size Size of the object.
+ *
+ * @return The object, released with `slab_free` like any other. Terminates the
+ *         program if allocation fails.
+ */
+void* slab_alloc_unowned(size_t size);
+
+/**
+ * @brief Returns an object to the slab it was allocated from.
+ *
+ * @param self  The calling worker's slab, may be `NULL`.
+ * @param p     The object.
+ */
+void slab_free(Slab* self, void* p);
+
+/**
+ * @brief Initializes an empty arena.
+ *
+ * @param arena The arena.
+ */
+void init_arena(NameArena* arena);
+
+/**
+ * @brief Frees every block of the arena.
+ *
+ * @param arena The arena.
+ */
+void destroy_arena(NameArena* arena);
+
+/**
+ * @brief Copies a name into the arena.
+ *
+ * @param arena The arena, only used by one thread at a time.
+ * @param name  The name.
+ *
+ * @return The copy, valid until the arena is destroyed. Terminates the program if
+ *         allocation fails.
+ */
+char* arena_strdup(NameArena* arena, const char* name);
+
+#endif
@@ -0,0 +1,52 @@
+#include "stats.h"
+void init_stats(WorkerStats* stats){
+    memset(stats, 0, sizeof(WorkerStats));
+    stats->largest_dir_path = NULL;
+}
+
+void destroy_stats(WorkerStats* stats){
+    free(stats->largest_dir_path);
+    stats->largest_dir_path = NULL;
+}
+
+void stats_directory(WorkerStats* stats, const DirRef* dir, long n){
+    if(n <= stats->largest_dir) return;
+    stats->largest_dir = n;
+    free(stats->largest_dir_path);
+    stats->largest_dir_path = build_path(dir->parent, dir->name);
+}
+
+void merge_stats(WorkerStats* total, const WorkerStats* stats){
+    total->entries          += stats->entries;
+    total->files            += stats->files;
+    total->lstat            += stats->lstat;
+    total->openat           += stats->openat;
+    total->getdents         += stats->getdents;
+    total->statx            += stats->statx;
+    total->uring_enter      += stats->uring_enter;
+    total->steals           += stats->steals;
+    total->parks            += stats->parks;
+    total->wakeups          += stats->wakeups;
+    total->queue_wait_ns    += stats->queue_wait_ns;
+    total->idle_ns          += stats->idle_ns;
+    total->ring_wait_ns     += stats->ring_wait_ns;
+
+    if(stats->largest_dir > total->largest_dir && stats->largest_dir_path != NULL){
+        total->largest_dir = stats->largest_dir;
+        free(total->largest_dir_path);
+        total->largest_dir_path = strdup(stats->largest_dir_path);
+    }
+}
+
+void print_stats_header(FILE* out){
+    fprintf(out, "%6s %9s %9s %9s %8s %8s %9s %8s %7s %7s %8s %10s %10s %10s %8s\n",
+        "worker", "entries", "files", "lstat", "openat", "getdents", "statx", "enter",
+        "steals", "parks", "wakeups", "queue_ms", "idle_ms", "ring_ms", "maxdir");
+}
+
+void print_stats(FILE* out, const char* label, const WorkerStats* stats){
+    fprintf(out, "%6s %9ld %9ld %9ld %8ld %8ld %9ld %8ld %7ld %7ld %8ld %10.3f %10.3f %10.3f %8ld\n",
+        label, stats->entries, stats->files, stats->lstat, stats->openat, stats->getdents,
+        stats->statx, stats->uring_enter, stats->steals, stats->parks, stats->wakeups,
+        stats->queue_wait_ns / 1e6, stats->idle_ns / 1e6, stats->ring_wait_ns / 1e6, stats->largest_dir);
+}
@@ -0,0 +1,133 @@
+/**
+ *
+ * This file defines the per-worker instrumentation counters printed by `--stats`.
+ * Every worker owns one `WorkerStats`, kept in its scheduler slot which is padded
+ * to a cache line, and only ever updates its own counters with plain increments.
+ * The counters are summed by the main thread after the workers are joined.
+ *
+ * The counters are only updated in builds with `MDU_STATS` defined, `make STATS=1`.
+ * Otherwise every `STATS_*` macro expands to nothing and the hot paths are the
+ * same as without instrumentation, `--stats` then prints a notice instead.
+ *
+ * Times are in nanoseconds from `CLOCK_MONOTONIC`. `queue_wait_ns` is the time
+ * spent taking entries from the shared injection queue, including waiting for its
+ * mutex, `idle_ns` the time parked in the scheduler and `ring_wait_ns` the time
+ * the uring engine waited in `io_uring_enter` for completions.
+ *
+ * @file stats.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Per-worker instrumentation counters.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "dirref.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <time.h>
+
+/**
+ * @note `entries` counts the entries taken from the scheduler, `files` the
+ *       files sized while listing their directory without becoming entries.
+ * @note `largest_dir` is the number of entries read from the largest directory
+ *       listed by the worker, `largest_dir_path` its path.
+ */
+typedef struct {
+    long entries;
+    long files;
+    long lstat;
+    long openat;
+    long getdents;
+    long statx;
+    long uring_enter;
+    long steals;
+    long parks;
+    long wakeups;
+    long queue_wait_ns;
+    long idle_ns;
+    long ring_wait_ns;
+    long largest_dir;
+    char* largest_dir_path;
+} WorkerStats;
+
+#ifdef MDU_STATS
+#define STATS_ENABLED true
+#define STATS_INC(counter)              ((counter)++)
+#define STATS_ADD(counter, n)           ((counter) += (n))
+#define STATS_CLOCK(var)                long var = stats_now()
+#define STATS_SINCE(counter, var)       ((counter) += stats_now() - (var))
+#define STATS_DIRECTORY(stats, dir, n)  stats_directory((stats), (dir), (n))
+#else
+#define STATS_ENABLED false
+#define STATS_INC(counter)              ((void)0)
+#define STATS_ADD(counter, n)           ((void)0)
+#define STATS_CLOCK(var)
+#define STATS_SINCE(counter, var)       ((void)0)
+#define STATS_DIRECTORY(stats, dir, n)  ((void)(stats), (void)(dir), (void)(n))
+#endif
+
+/**
+ * @brief Returns the current time in nanoseconds.
+ */
+static inline long stats_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000L + ts.tv_nsec;
+}
+
+/**
+ * @brief Zeroes a worker's counters.
+ *
+ * @param stats Pointer to the counters.
+ */
+void init_stats(WorkerStats* stats);
+
+/**
+ * @brief Frees the path of the largest directory.
+ *
+ * @param stats Pointer to the counters.
+ */
+void destroy_stats(WorkerStats* stats);
+
+/**
+ * @brief Records the size of a listed directory.
+ *
+ * @param stats Pointer to the listing worker's counters.
+ * @param dir   The listed directory.
+ * @param n     Number of entries read from it.
+ *
+ * @note The path is only built when `dir` is the largest directory so far.
+ */
+void stats_directory(WorkerStats* stats, const DirRef* dir, long n);
+
+/**
+ * @brief Adds one worker's counters to a total.
+ *
+ * Sums every counter and keeps the larger of the two largest directories, whose
+ * path is copied.
+ *
+ * @param total Pointer to the total, initialized with `init_stats`.
+ * @param stats Pointer to the worker's counters.
+ */
+void merge_stats(WorkerStats* total, const WorkerStats* stats);
+
+/**
+ * @brief Prints the header of the stats table.
+ *
+ * @param out The stream to print to.
+ */
+void print_stats_header(FILE* out);
+
+/**
+ * @brief Prints one row of the stats table.
+ *
+ * @param out   The stream to print to.
+ * @param label Name of the row, the worker index or `total`.
+ * @param stats Pointer to the counters.
+ */
+void print_stats(FILE* out, const char* label, const WorkerStats* stats);
+
+#endif
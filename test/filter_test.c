@@ -0,0 +1,96 @@
+/**
+ *
+ * Checks of the names kept and dropped by the `--exclude` and `--include` rules,
+ * see filter.h. Every check matches one name against a filter built from a list
+ * of rules and compares the result with the expected one.
+ *
+ * To run:
+ *   make test
+ *
+ * Prints every failed check and exits with a failure status if there was one.
+ *
+ * @file filter_test.c
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Tests of the exclude and include rule matcher.
+ */
+
+#include "filter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+static int failures = 0;
+
+static void check(const Filter* f, const char* rules, const char* name, bool dir, bool excluded){
+    FilterMatcher m;
+    init_matcher(&m, f);
+    if(filter_excludes(&m, name, dir) != excluded){
+        fprintf(stderr, "%s: %s %s should be %s\n", rules, dir ? "directory" : "file", name, excluded ? "excluded" : "kept");
+        failures++;
+    }
+    destroy_matcher(&m);
+}
+
+static Filter* build(FilterSyntax syntax, const char* include, const char* exclude){
+    Filter* f = create_filter();
+    if(include != NULL && filter_add(f, syntax, true, include) != 0) exit(EXIT_FAILURE);
+    if(exclude != NULL && filter_add(f, syntax, false, exclude) != 0) exit(EXIT_FAILURE);
+    return f;
+}
+
+static void test_exclude_only(void){
+    Filter* f = build(FILTER_GLOB, NULL, "*.tmp");
+    check(f, "--exclude=*.tmp", "a.tmp", false, true);
+    check(f, "--exclude=*.tmp", "a.tmp", true, true);
+    check(f, "--exclude=*.tmp", "a.txt", false, false);
+    check(f, "--exclude=*.tmp", "b", false, false);
+    destroy_filter(f);
+}
+
+static void test_include_only(void){
+    Filter* f = build(FILTER_GLOB, "f1*", NULL);
+    check(f, "--include=f1*", "f1", false, false);
+    check(f, "--include=f1*", "f1x", false, false);
+    check(f, "--include=f1*", "f2", false, true);
+    check(f, "--include=f1*", "g1", false, true);
+    //Directories are still listed for the names included below them.
+    check(f, "--include=f1*", "sub", true, false);
+    check(f, "--include=f1*", "f1dir", true, false);
+    destroy_filter(f);
+
+    //Names ending in no rule's last character take the fast path.
+    f = build(FILTER_GLOB, "*.log", NULL);
+    check(f, "--include=*.log", "a.log", false, false);
+    check(f, "--include=*.log", "a.txt", false, true);
+    check(f, "--include=*.log", "a.txt", true, false);
+    destroy_filter(f);
+
+    f = build(FILTER_REGEX, "f[0-9]+", NULL);
+    check(f, "--include-regex=f[0-9]+", "f12", false, false);
+    check(f, "--include-regex=f[0-9]+", "f12x", false, true);
+    check(f, "--include-regex=f[0-9]+", "dir", true, false);
+    destroy_filter(f);
+}
+
+static void test_include_and_exclude(void){
+    //The first matching rule decides, names no rule matches are kept.
+    Filter* f = build(FILTER_GLOB, "f1*", "f*");
+    check(f, "--include=f1* --exclude=f*", "f1", false, false);
+    check(f, "--include=f1* --exclude=f*", "f2", false, true);
+    check(f, "--include=f1* --exclude=f*", "g1", false, false);
+    check(f, "--include=f1* --exclude=f*", "fdir", true, true);
+    destroy_filter(f);
+}
+
+int main(void){
+    test_exclude_only();
+    test_include_only();
+    test_include_and_exclude();
+    if(failures > 0){
+        fprintf(stderr, "%d checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("filter_test: all checks passed\n");
+    return EXIT_SUCCESS;
+}
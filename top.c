@@ -0,0 +1,77 @@
+#include "top.h"
+void init_top(TopHeap* h, int cap){
+    h->n        = 0;
+    h->cap      = cap;
+    h->entries  = NULL;
+    if(cap == 0) return;
+
+    h->entries = malloc(cap * sizeof(TopEntry));
+    if(h->entries == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void destroy_top(TopHeap* h){
+    for(int i = 0; i < h->n; i++) free(h->entries[i].path);
+    free(h->entries);
+    h->entries  = NULL;
+    h->n        = 0;
+}
+
+static void sift_down(TopHeap* h, int i){
+    TopEntry* e = h->entries;
+    while(1){
+        int smallest = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if(left < h->n && e[left].size < e[smallest].size) smallest = left;
+        if(right < h->n && e[right].size < e[smallest].size) smallest = right;
+        if(smallest == i) return;
+
+        TopEntry tmp = e[i];
+        e[i] = e[smallest];
+        e[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static void sift_up(TopHeap* h, int i){
+    TopEntry* e = h->entries;
+    while(i > 0 && e[(i - 1) / 2].size > e[i].size){
+        TopEntry tmp = e[i];
+        e[i] = e[(i - 1) / 2];
+        e[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+}
+
+void top_insert(TopHeap* h, long size, char* path){
+    if(h->n < h->cap){
+        h->entries[h->n] = (TopEntry){ size, path };
+        sift_up(h, h->n++);
+        return;
+    }
+    free(h->entries[0].path);
+    h->entries[0] = (TopEntry){ size, path };
+    sift_down(h, 0);
+}
+
+void merge_top(TopHeap* total, TopHeap* h){
+    for(int i = 0; i < h->n; i++){
+        if(top_wants(total, h->entries[i].size)) top_insert(total, h->entries[i].size, h->entries[i].path);
+        else free(h->entries[i].path);
+    }
+    h->n = 0;
+}
+
+static int compare_top(const void* a, const void* b){
+    const TopEntry* ea = a;
+    const TopEntry* eb = b;
+    if(ea->size != eb->size) return ea->size < eb->size ? 1 : -1;
+    return strcmp(ea->path, eb->path);
+}
+
+void sort_top(TopHeap* h){
+    if(h->n > 0) qsort(h->entries, h->n, sizeof(TopEntry), compare_top);
+}
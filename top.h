@@ -0,0 +1,89 @@
+/**
+ *
+ * This file defines the bounded heaps behind `--top N`. Every worker keeps one
+ * heap of the largest files and one of the largest directories it completed, each
+ * holding at most N entries with the smallest at the root. An entry only becomes
+ * a path once it is known to make it into the heap, so the cost for the many
+ * entries that do not is one comparison. The workers' heaps are merged into the
+ * scan's heaps when they are joined, no heap is ever shared between threads.
+ *
+ * @file top.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Per-worker heaps of the largest entries.
+ */
+
+#ifndef TOP_H
+#define TOP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+typedef struct {
+    long size;
+    char* path;
+} TopEntry;
+
+/**
+ * @note `cap` is N, a heap with `cap` 0 takes no entries.
+ */
+typedef struct {
+    TopEntry* entries;
+    int n;
+    int cap;
+} TopHeap;
+
+/**
+ * @brief Initializes an empty heap.
+ *
+ * @param h     Pointer to the heap.
+ * @param cap   Most entries kept.
+ */
+void init_top(TopHeap* h, int cap);
+
+/**
+ * @brief Frees the heap and the paths it holds.
+ *
+ * @param h Pointer to the heap.
+ */
+void destroy_top(TopHeap* h);
+
+/**
+ * @brief Returns whether an entry of `size` blocks would be kept.
+ *
+ * @param h     Pointer to the heap.
+ * @param size  Size of the entry in blocks.
+ */
+static inline bool top_wants(const TopHeap* h, long size){
+    return h->n < h->cap || (h->cap > 0 && size > h->entries[0].size);
+}
+
+/**
+ * @brief Adds an entry, replacing the smallest one if the heap is full.
+ *
+ * @param h     Pointer to the heap.
+ * @param size  Size of the entry in blocks.
+ * @param path  Path of the entry, allocated, owned by the heap from now on.
+ *
+ * @note Only call when `top_wants` returned true.
+ */
+void top_insert(TopHeap* h, long size, char* path);
+
+/**
+ * @brief Moves every entry of `h` that belongs to the top of `total` into it.
+ *
+ * @param total Pointer to the merged heap.
+ * @param h     Pointer to a worker's heap, left empty.
+ */
+void merge_top(TopHeap* total, TopHeap* h);
+
+/**
+ * @brief Sorts the entries largest first, ties by path.
+ *
+ * @param h Pointer to the heap, no longer a heap afterwards.
+ */
+void sort_top(TopHeap* h);
+
+#endif
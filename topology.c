@@ -0,0 +1,156 @@
+#define _GNU_SOURCE
+#include "topology.h"
+#include <ctype.h>
+#include <dirent.h>
+#include <sched.h>
+
+//Adds the CPUs of a list such as 0-3,8 to `set`, -1 if it is not one.
+static int parse_cpu_list(const char* list, cpu_set_t* set){
+    const char* p = list;
+    while(1){
+        if(!isdigit((unsigned char)*p)) return -1;
+        char* end;
+        long lo = strtol(p, &end, 10);
+        long hi = lo;
+        if(*end == '-'){
+            p = end + 1;
+            if(!isdigit((unsigned char)*p)) return -1;
+            hi = strtol(p, &end, 10);
+        }
+        if(hi < lo || hi >= CPU_SETSIZE) return -1;
+        for(long cpu = lo; cpu <= hi; cpu++) CPU_SET(cpu, set);
+
+        if(*end == '\n' || *end == '\0') return 0;
+        if(*end != ',') return -1;
+        p = end + 1;
+    }
+}
+
+static bool read_node_cpus(int node, cpu_set_t* set){
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* f = fopen(path, "r");
+    if(f == NULL) return false;
+
+    char line[4096];
+    bool ok = fgets(line, sizeof(line), f) != NULL && parse_cpu_list(line, set) == 0;
+    fclose(f);
+    return ok;
+}
+
+//Returns the system numbers of the nodes in ascending order, none without sysfs.
+static int read_nodes(int** nodes){
+    *nodes = NULL;
+    DIR* d = opendir("/sys/devices/system/node");
+    if(d == NULL) return 0;
+
+    int n = 0, cap = 0;
+    struct dirent* dp;
+    while((dp = readdir(d)) != NULL){
+        if(strncmp(dp->d_name, "node", 4) != 0 || !isdigit((unsigned char)dp->d_name[4])) continue;
+        if(n == cap){
+            cap = cap == 0 ? 8 : cap * 2;
+            int* grown = realloc(*nodes, cap * sizeof(int));
+            if(grown == NULL){
+                perror("realloc");
+                exit(EXIT_FAILURE);
+            }
+            *nodes = grown;
+        }
+        int node = atoi(dp->d_name + 4);
+        int i = n++;
+        for(; i > 0 && (*nodes)[i - 1] > node; i--) (*nodes)[i] = (*nodes)[i - 1];
+        (*nodes)[i] = node;
+    }
+    closedir(d);
+    return n;
+}
+
+Topology* create_topology(const char* cpus, bool numa){
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) == -1){
+        perror("sched_getaffinity");
+        exit(EXIT_FAILURE);
+    }
+    if(cpus != NULL){
+        cpu_set_t listed;
+        CPU_ZERO(&listed);
+        if(parse_cpu_list(cpus, &listed) == -1) return NULL;
+        CPU_AND(&allowed, &allowed, &listed);
+    }
+    int ncpus = CPU_COUNT(&allowed);
+    if(ncpus == 0) return NULL;
+
+    Topology* t = malloc(sizeof(Topology));
+    int* sys_nodes;
+    int nsys = read_nodes(&sys_nodes);
+    if(t != NULL){
+        t->cpus     = malloc(ncpus * sizeof(int));
+        t->nodes    = malloc(ncpus * sizeof(int));
+        t->first    = malloc((nsys + 2) * sizeof(int));
+    }
+    if(t == NULL || t->cpus == NULL || t->nodes == NULL || t->first == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    t->ncpus    = 0;
+    t->nnodes   = 0;
+    t->per_cpu  = cpus != NULL;
+    t->numa     = numa;
+
+    //Nodes without an allowed CPU are left out, CPUs sysfs places on no node form the last one.
+    cpu_set_t placed;
+    CPU_ZERO(&placed);
+    for(int i = 0; i <= nsys; i++){
+        cpu_set_t node;
+        CPU_ZERO(&node);
+        if(i < nsys && !read_node_cpus(sys_nodes[i], &node)) continue;
+        if(i == nsys) CPU_XOR(&node, &allowed, &placed);
+
+        int before = t->ncpus;
+        for(int cpu = 0; cpu < CPU_SETSIZE && t->ncpus < ncpus; cpu++){
+            if(!CPU_ISSET(cpu, &node) || !CPU_ISSET(cpu, &allowed) || CPU_ISSET(cpu, &placed)) continue;
+            CPU_SET(cpu, &placed);
+            t->cpus[t->ncpus]   = cpu;
+            t->nodes[t->ncpus]  = t->nnodes;
+            t->ncpus++;
+        }
+        if(t->ncpus > before) t->first[t->nnodes++] = before;
+    }
+    t->first[t->nnodes] = t->ncpus;
+    free(sys_nodes);
+    return t;
+}
+
+void destroy_topology(Topology* t){
+    if(t == NULL) return;
+    free(t->cpus);
+    free(t->nodes);
+    free(t->first);
+    free(t);
+}
+
+//Returns the index in `cpus` of the CPU a worker is pinned to when pinned to one.
+static int worker_cpu(const Topology* t, int worker){
+    if(!t->numa) return worker % t->ncpus;
+    int node = worker % t->nnodes;
+    int size = t->first[node + 1] - t->first[node];
+    return t->first[node] + (worker / t->nnodes) % size;
+}
+
+int topology_node(const Topology* t, int worker){
+    return t->nodes[worker_cpu(t, worker)];
+}
+
+int topology_pin(const Topology* t, int worker, pthread_attr_t* attr){
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(t->per_cpu || !t->numa){
+        CPU_SET(t->cpus[worker_cpu(t, worker)], &set);
+    } else {
+        int node = topology_node(t, worker);
+        for(int i = t->first[node]; i < t->first[node + 1]; i++) CPU_SET(t->cpus[i], &set);
+    }
+    return pthread_attr_setaffinity_np(attr, sizeof(set), &set);
+}
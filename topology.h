@@ -0,0 +1,94 @@
+/**
+ *
+ * This file defines the CPU placement of the workers, set by `--cpus` and `--numa`.
+ * Without either the workers are left to the kernel, which migrates them freely
+ * between CPUs and, on machines with several NUMA nodes, between sockets.
+ *
+ * The CPUs the process may run on are read with sched_getaffinity(2), narrowed to
+ * the `--cpus` list if given, and grouped by the NUMA node they belong to as listed
+ * in `/sys/devices/system/node`. A machine without that directory is one node.
+ *
+ * With `--cpus` every worker is pinned to a single CPU of the list, worker `i` to
+ * the `i`-th one, wrapping around. With `--numa` the workers are dealt round robin
+ * over the nodes and pinned to the CPUs of their node, or to a single one of them
+ * if `--cpus` was given too, so every node gets its share of the workers and
+ * workers on one node stay there.
+ *
+ * The affinity is set on the thread's attributes before it is created, so the
+ * worker runs on its CPUs from its first instruction. The memory a worker allocates
+ * for itself, its slab, arenas, directory buffer and deque, is first touched on
+ * those CPUs and thereby placed on the worker's node by the kernel's default local
+ * allocation policy. The node of every worker is handed to the scheduler as well,
+ * whose workers steal from workers on their own node first, see scheduler.h.
+ *
+ * @file topology.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief CPU and NUMA node placement of the workers.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/**
+ * @note `cpus` holds the CPUs workers may be placed on, grouped by node, the CPUs
+ *       of node `k` are `cpus[first[k]]` up to `cpus[first[k + 1]]`. Nodes are
+ *       numbered from 0 in the order of their system numbers, without gaps.
+ * @note `per_cpu` is set by `--cpus`, every worker is then pinned to one CPU.
+ *       `numa` is set by `--numa`.
+ */
+typedef struct {
+    int ncpus;
+    int* cpus;
+    int* nodes;
+    int nnodes;
+    int* first;
+    bool per_cpu;
+    bool numa;
+} Topology;
+
+/**
+ * @brief Reads the CPUs and NUMA nodes workers may be placed on.
+ *
+ * @param cpus  A list of CPUs as in `0-3,8,10-11`, `NULL` for every CPU the
+ *              process may run on.
+ * @param numa  Whether workers are placed by node, see above.
+ *
+ * @return The topology, freed with `destroy_topology`, or `NULL` if `cpus` is not
+ *         a valid list or names no CPU the process may run on.
+ */
+Topology* create_topology(const char* cpus, bool numa);
+
+/**
+ * @brief Frees a topology.
+ *
+ * @param t Pointer to the topology, may be `NULL`.
+ */
+void destroy_topology(Topology* t);
+
+/**
+ * @brief Returns the node a worker is placed on.
+ *
+ * @param t         Pointer to the topology.
+ * @param worker    Index of the worker.
+ */
+int topology_node(const Topology* t, int worker);
+
+/**
+ * @brief Sets the CPUs a worker is pinned to on the attributes it is created with.
+ *
+ * @param t         Pointer to the topology.
+ * @param worker    Index of the worker.
+ * @param attr      Attributes passed to pthread_create(3).
+ *
+ * @return 0 on success, the error of pthread_attr_setaffinity_np(3) otherwise.
+ */
+int topology_pin(const Topology* t, int worker, pthread_attr_t* attr);
+
+#endif
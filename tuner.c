@@ -0,0 +1,112 @@
+#include "tuner.h"
+int tuner_default_max(void){
+    long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long max = 4 * (ncpus < 1 ? 1 : ncpus);
+    if(max < 8) max = 8;
+    if(max > 64) max = 64;
+    return max;
+}
+
+static int next_move(Tuner* t, double rate, int idle){
+    int grow = t->active / 2 < 1 ? 1 : t->active / 2;
+    if(t->move > 0 && rate <= t->last_rate * (1 + TUNER_TOLERANCE)){
+        t->hold = TUNER_HOLD;
+        return -t->move;
+    }
+    if(t->move < 0 && rate < t->last_rate * (1 - TUNER_TOLERANCE)){
+        t->hold = TUNER_HOLD;
+        return -t->move;
+    }
+    if(t->move < 0) return -1;
+    if(t->move > 0 && idle == 0) return grow;
+    if(t->move > 0){
+        t->hold = TUNER_HOLD;
+        return 0;
+    }
+    if(--t->hold > 0) return 0;
+    return idle > 0 ? -1 : grow;
+}
+
+static void tune(Tuner* t){
+    long time = stats_now();
+    long completed = sched_completed(t->sched);
+    //Nothing completed, the scan has not started or is done.
+    if(completed == t->last_completed) return;
+
+    double rate = (completed - t->last_completed) * 1e9 / (time - t->last_time);
+    int active = t->active + next_move(t, rate, sched_idle(t->sched));
+    if(active > t->max) active = t->max;
+    if(active < 1) active = 1;
+
+    t->move = active - t->active;
+    t->active = active;
+    if(active > t->peak) t->peak = active;
+    t->last_rate = rate;
+    t->last_completed = completed;
+    t->last_time = time;
+    sched_set_active(t->sched, active);
+}
+
+static void* tuner_thread(void* arg){
+    Tuner* t = (Tuner*)arg;
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    pthread_mutex_lock(&t->lock);
+    while(!t->stop){
+        deadline.tv_nsec += TUNER_INTERVAL_MS * 1000000L;
+        if(deadline.tv_nsec >= 1000000000L){
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while(!t->stop && pthread_cond_timedwait(&t->cond, &t->lock, &deadline) == 0);
+        if(!t->stop) tune(t);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return NULL;
+}
+
+Tuner* start_tuner(Scheduler* sched){
+    Tuner* t = malloc(sizeof(Tuner));
+    if(t == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+
+    t->sched          = sched;
+    t->max            = sched->nworkers;
+    t->active         = TUNER_START < t->max ? TUNER_START : t->max;
+    t->peak           = t->active;
+    t->move           = 0;
+    t->hold           = 1;
+    t->last_rate      = 0;
+    t->last_completed = sched_completed(sched);
+    t->last_time      = stats_now();
+    t->stop           = false;
+    sched_set_active(sched, t->active);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    pthread_mutex_init(&t->lock, NULL);
+    if(pthread_create(&t->thread, NULL, tuner_thread, t) != 0){
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    return t;
+}
+
+void stop_tuner(Tuner* t, int* peak){
+    pthread_mutex_lock(&t->lock);
+    t->stop = true;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    pthread_join(t->thread, NULL);
+
+    if(peak != NULL) *peak = t->peak;
+    pthread_cond_destroy(&t->cond);
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+}
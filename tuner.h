@@ -0,0 +1,87 @@
+/**
+ *
+ * This file defines the controller behind `-j auto`. All workers up to a cap are
+ * started, but only a few are let into the scheduler, see `sched_set_active`. A
+ * controller thread samples the number of completed entries every
+ * `TUNER_INTERVAL_MS` and moves the number of active workers by hill climbing on
+ * the measured entries per second:
+ * - A probe upwards adds half of the active workers, and is followed by another
+ *   one as long as the rate keeps rising by more than `TUNER_TOLERANCE`.
+ * - A probe downwards removes one worker at a time, as long as the rate does not
+ *   fall by more than `TUNER_TOLERANCE`.
+ * - A move that did not pay off is undone and the count is held for
+ *   `TUNER_HOLD` intervals before probing again.
+ *
+ * With a fixed number of entries in flight per worker the time an entry takes is
+ * the number of active workers divided by the rate, so a probe upwards that does
+ * not raise the rate is one that only made every system call slower, on a device
+ * that is already saturated. Probes go downwards while workers are parked for
+ * lack of work, since the tree cannot feed more of them.
+ *
+ * @file tuner.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Adaptive number of active workers for `-j auto`.
+ */
+
+#ifndef TUNER_H
+#define TUNER_H
+
+#include "scheduler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+#define TUNER_INTERVAL_MS   20
+#define TUNER_TOLERANCE     0.05
+#define TUNER_HOLD          5
+#define TUNER_START         2
+
+/**
+ * @note `move` is the change made at the last interval, measured by the next one.
+ * @note `peak` is the largest number of active workers reached.
+ */
+typedef struct {
+    Scheduler* sched;
+    int max;
+    int active;
+    int peak;
+    int move;
+    int hold;
+    double last_rate;
+    long last_completed;
+    long last_time;
+    bool stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} Tuner;
+
+/**
+ * @brief Returns the default cap of `-j auto`.
+ *
+ * @return Four workers per online CPU, at least 8 and at most 64.
+ */
+int tuner_default_max(void);
+
+/**
+ * @brief Lowers the active workers to `TUNER_START` and starts the controller.
+ *
+ * @param sched Pointer to the scheduler, created with the cap as its number of workers.
+ *
+ * @return Pointer to the running controller.
+ */
+Tuner* start_tuner(Scheduler* sched);
+
+/**
+ * @brief Stops and frees the controller.
+ *
+ * @param t     Pointer to the controller.
+ * @param peak  Receives the largest number of active workers reached, may be `NULL`.
+ */
+void stop_tuner(Tuner* t, int* peak);
+
+#endif
@@ -0,0 +1,117 @@
+#include "uring.h"
+#define load_acquire(p)     atomic_load_explicit((_Atomic unsigned int*)(p), memory_order_acquire)
+#define store_release(p, v) atomic_store_explicit((_Atomic unsigned int*)(p), (v), memory_order_release)
+
+int uring_init(Uring* ring, unsigned int entries){
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(ring, 0, sizeof(*ring));
+
+    int fd = syscall(__NR_io_uring_setup, entries, &p);
+    if(fd < 0) return -errno;
+
+    ring->fd            = fd;
+    ring->sq_entries    = p.sq_entries;
+    ring->cq_entries    = p.cq_entries;
+    ring->sq_ring_size  = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    ring->cq_ring_size  = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size     = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        if(ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ring == MAP_FAILED) goto fail;
+
+    if(p.features & IORING_FEAT_SINGLE_MMAP){
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if(ring->cq_ring == MAP_FAILED) goto fail;
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED) goto fail;
+
+    char* sq = ring->sq_ring;
+    char* cq = ring->cq_ring;
+    ring->sq_head   = (unsigned int*)(sq + p.sq_off.head);
+    ring->sq_tail   = (unsigned int*)(sq + p.sq_off.tail);
+    ring->sq_mask   = (unsigned int*)(sq + p.sq_off.ring_mask);
+    ring->sq_array  = (unsigned int*)(sq + p.sq_off.array);
+    ring->cq_head   = (unsigned int*)(cq + p.cq_off.head);
+    ring->cq_tail   = (unsigned int*)(cq + p.cq_off.tail);
+    ring->cq_mask   = (unsigned int*)(cq + p.cq_off.ring_mask);
+    ring->cqes      = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    ring->sqe_tail  = *ring->sq_tail;
+    return 0;
+
+fail:;
+    int err = errno;
+    uring_destroy(ring);
+    return -err;
+}
+
+void uring_destroy(Uring* ring){
+    if(ring->sqes != NULL && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if(ring->cq_ring != NULL && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring){
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if(ring->sq_ring != NULL && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    if(ring->fd > 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+}
+
+struct io_uring_sqe* uring_get_sqe(Uring* ring){
+    unsigned int head = load_acquire(ring->sq_head);
+    if(ring->sqe_tail - head >= ring->sq_entries) return NULL;
+
+    unsigned int index = ring->sqe_tail & *ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[index];
+    ring->sq_array[index] = index;
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int uring_submit(Uring* ring, unsigned int wait_nr){
+    unsigned int to_submit = ring->sqe_tail - *ring->sq_tail;
+    store_release(ring->sq_tail, ring->sqe_tail);
+
+    if(to_submit == 0 && wait_nr == 0) return 0;
+
+    int ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr,
+            wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while(ret < 0 && errno == EINTR);
+    return ret < 0 ? -errno : ret;
+}
+
+struct io_uring_cqe* uring_peek_cqe(Uring* ring){
+    unsigned int head = *ring->cq_head;
+    if(head == load_acquire(ring->cq_tail)) return NULL;
+    return &ring->cqes[head & *ring->cq_mask];
+}
+
+void uring_cqe_seen(Uring* ring){
+    store_release(ring->cq_head, *ring->cq_head + 1);
+}
+
+bool uring_supports(Uring* ring, int op){
+    size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = calloc(1, size);
+    if(probe == NULL) return false;
+
+    bool supported = false;
+    if(syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) == 0){
+        supported = op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return supported;
+}
@@ -0,0 +1,118 @@
+/**
+ *
+ * This file defines a minimal io_uring submission/completion ring built on the
+ * raw system calls and the kernel's <linux/io_uring.h>, so no liburing is needed.
+ * Only what the uring engine uses is provided: setting up and mapping a ring,
+ * handing out submission entries, submitting and waiting in one `io_uring_enter`
+ * call, iterating completions and probing for supported opcodes.
+ *
+ * A ring belongs to a single thread, none of the functions are thread safe.
+ *
+ * @file uring.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Minimal raw io_uring ring.
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+typedef struct {
+    int fd;
+    unsigned int sq_entries;
+    unsigned int cq_entries;
+
+    unsigned int* sq_head;
+    unsigned int* sq_tail;
+    unsigned int* sq_mask;
+    unsigned int* sq_array;
+    struct io_uring_sqe* sqes;
+    unsigned int sqe_tail;
+
+    unsigned int* cq_head;
+    unsigned int* cq_tail;
+    unsigned int* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ring;
+    size_t sq_ring_size;
+    void* cq_ring;
+    size_t cq_ring_size;
+    size_t sqes_size;
+} Uring;
+
+/**
+ * @brief Creates a ring with room for `entries` submissions and maps it.
+ *
+ * @param ring      Pointer to the ring to initialize.
+ * @param entries   Number of submission queue entries, a power of two.
+ *
+ * @return 0 on success, otherwise a negative errno value, for example `-ENOSYS`
+ *         when the kernel lacks io_uring or `-EPERM` when it is disabled.
+ */
+int uring_init(Uring* ring, unsigned int entries);
+
+/**
+ * @brief Unmaps and closes the ring.
+ *
+ * @param ring Pointer to the ring.
+ */
+void uring_destroy(Uring* ring);
+
+/**
+ * @brief Returns a cleared submission entry to fill in.
+ *
+ * @param ring Pointer to the ring.
+ *
+ * @return The entry, or `NULL` if every slot is waiting to be submitted.
+ */
+struct io_uring_sqe* uring_get_sqe(Uring* ring);
+
+/**
+ * @brief Submits all prepared entries and waits for completions.
+ *
+ * @param ring      Pointer to the ring.
+ * @param wait_nr   Number of completions to wait for, 0 to return immediately.
+ *
+ * @return The number of entries submitted, or a negative errno value.
+ */
+int uring_submit(Uring* ring, unsigned int wait_nr);
+
+/**
+ * @brief Returns the oldest unconsumed completion without waiting.
+ *
+ * @param ring Pointer to the ring.
+ *
+ * @return The completion, or `NULL` if none is ready. Release it with `uring_cqe_seen`.
+ */
+struct io_uring_cqe* uring_peek_cqe(Uring* ring);
+
+/**
+ * @brief Marks the completion returned by `uring_peek_cqe` as consumed.
+ *
+ * @param ring Pointer to the ring.
+ */
+void uring_cqe_seen(Uring* ring);
+
+/**
+ * @brief Checks whether the kernel implements an operation.
+ *
+ * @param ring  Pointer to an initialized ring.
+ * @param op    The `IORING_OP_*` opcode.
+ *
+ * @return true if the opcode is supported, false if not or if probing failed.
+ */
+bool uring_supports(Uring* ring, int op);
+
+#endif
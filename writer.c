@@ -0,0 +1,258 @@
+#include "writer.h"
+static const char* RECORD_TYPES[] = { "file", "dir", "total" };
+
+//Buffers are found by the id of their writer, so a thread never touches the buffer
+//of a writer it no longer belongs to.
+static atomic_ulong next_id = 1;
+static _Thread_local unsigned long local_id;
+static _Thread_local WriterBuffer* local;
+
+static int write_all(int fd, struct iovec* v, int n){
+    while(n > 0){
+        ssize_t written = writev(fd, v, n);
+        if(written == -1){
+            if(errno == EINTR) continue;
+            return errno;
+        }
+        while(n > 0 && (size_t)written >= v->iov_len){
+            written -= v->iov_len;
+            v++;
+            n--;
+        }
+        if(n > 0){
+            v->iov_base = (char*)v->iov_base + written;
+            v->iov_len -= written;
+        }
+    }
+    return 0;
+}
+
+static void* writer_thread(void* arg){
+    Writer* w = (Writer*)arg;
+    pthread_mutex_lock(&w->lock);
+    while(1){
+        while(w->head == NULL && !w->stop) pthread_cond_wait(&w->queued_cond, &w->lock);
+        if(w->head == NULL) break;
+
+        WriterBuffer* batch[WRITER_IOV];
+        struct iovec iov[WRITER_IOV];
+        int n = 0;
+        while(w->head != NULL && n < WRITER_IOV){
+            batch[n] = w->head;
+            iov[n] = (struct iovec){ batch[n]->data, batch[n]->len };
+            w->head = w->head->next;
+            w->queued--;
+            n++;
+        }
+        if(w->head == NULL) w->tail = NULL;
+        w->writing = true;
+        int error = w->error;
+        pthread_mutex_unlock(&w->lock);
+
+        if(error == 0) error = write_all(w->fd, iov, n);
+
+        pthread_mutex_lock(&w->lock);
+        w->error = error;
+        for(int i = 0; i < n; i++){
+            batch[i]->len   = 0;
+            batch[i]->next  = w->free;
+            w->free         = batch[i];
+        }
+        w->writing = false;
+        pthread_cond_broadcast(&w->space_cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+Writer* start_writer(int fd, OutputFormat format){
+    Writer* w = calloc(1, sizeof(Writer));
+    if(w == NULL){
+        perror("calloc");
+        exit(EXIT_FAILURE);
+    }
+    w->fd       = fd;
+    w->format   = format;
+    w->id       = atomic_fetch_add(&next_id, 1);
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->queued_cond, NULL);
+    pthread_cond_init(&w->space_cond, NULL);
+
+    //The magic goes out before any thread can queue a record.
+    if(format == FORMAT_BIN){
+        struct iovec magic = { WRITER_MAGIC, strlen(WRITER_MAGIC) };
+        w->error = write_all(fd, &magic, 1);
+    }
+
+    int err = pthread_create(&w->thread, NULL, writer_thread, w);
+    if(err != 0){
+        errno = err;
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    return w;
+}
+
+//Called with the lock held.
+static void enqueue(Writer* w, WriterBuffer* b){
+    b->held = false;
+    b->next = NULL;
+    if(w->tail != NULL) w->tail->next = b;
+    else w->head = b;
+    w->tail = b;
+    w->queued++;
+    pthread_cond_signal(&w->queued_cond);
+}
+
+//Called with the lock held.
+static WriterBuffer* new_buffer(Writer* w, size_t need){
+    WriterBuffer* b = w->free;
+    if(b != NULL && b->cap >= need){
+        w->free = b->next;
+        return b;
+    }
+
+    b = malloc(sizeof(WriterBuffer));
+    size_t cap = need > WRITER_BUFFER_SIZE ? need : WRITER_BUFFER_SIZE;
+    char* data = malloc(cap);
+    if(b == NULL || data == NULL){
+        perror("malloc");
+        exit(EXIT_FAILURE);
+    }
+    *b = (WriterBuffer){ .next = NULL, .all = w->all, .held = false, .len = 0, .cap = cap, .data = data };
+    w->all = b;
+    return b;
+}
+
+//Returns the calling thread's buffer with room for `need` more bytes.
+static WriterBuffer* reserve(Writer* w, size_t need){
+    WriterBuffer* b = local_id == w->id ? local : NULL;
+    if(b != NULL && b->cap - b->len >= need) return b;
+
+    pthread_mutex_lock(&w->lock);
+    if(b != NULL){
+        while(w->queued >= WRITER_QUEUE) pthread_cond_wait(&w->space_cond, &w->lock);
+        enqueue(w, b);
+    }
+    b = new_buffer(w, need);
+    b->held = true;
+    pthread_mutex_unlock(&w->lock);
+    local       = b;
+    local_id    = w->id;
+    return b;
+}
+
+static char* escape_json(char* out, const char* raw, size_t len){
+    static const char hex[] = "0123456789abcdef";
+    for(size_t i = 0; i < len; i++){
+        unsigned char c = raw[i];
+        if(c == '"' || c == '\\'){
+            *out++ = '\\';
+            *out++ = c;
+        } else if(c == '\n'){
+            *out++ = '\\';
+            *out++ = 'n';
+        } else if(c == '\t'){
+            *out++ = '\\';
+            *out++ = 't';
+        } else if(c < 0x20){
+            memcpy(out, "\\u00", 4);
+            out[4] = hex[c >> 4];
+            out[5] = hex[c & 15];
+            out += 6;
+        } else {
+            *out++ = c;
+        }
+    }
+    return out;
+}
+
+void write_record(Writer* w, RecordType type, const DirRef* parent, const char* name, long blocks){
+    size_t len = path_length(parent, name);
+    WriterBuffer* b;
+    char* out;
+    int n;
+    switch (w->format) {
+        case FORMAT_TSV:
+            b = reserve(w, len + 24);
+            out = b->data + b->len;
+            n = sprintf(out, "%ld\t", blocks);
+            write_path(out + n, len, parent, name);
+            out[n + len] = '\n';
+            b->len += n + len + 1;
+            break;
+
+        case FORMAT_NDJSON: {
+            //The raw path goes behind the room its escaped form may take and is escaped
+            //forward, the escaped bytes never catch up with the raw ones still to read.
+            b = reserve(w, 7 * len + 64);
+            out = b->data + b->len;
+            n = sprintf(out, "{\"type\":\"%s\",\"blocks\":%ld,\"path\":\"", RECORD_TYPES[type], blocks);
+            char* raw = out + n + 6 * len;
+            write_path(raw, len, parent, name);
+            char* end = escape_json(out + n, raw, len);
+            memcpy(end, "\"}\n", 3);
+            b->len += end + 3 - out;
+            break;
+        }
+
+        case FORMAT_BIN: {
+            WriterRecord r = { .type = type, .reserved = { 0 }, .path_len = len, .blocks = blocks };
+            b = reserve(w, sizeof(r) + len);
+            out = b->data + b->len;
+            memcpy(out, &r, sizeof(r));
+            write_path(out + sizeof(r), len, parent, name);
+            b->len += sizeof(r) + len;
+            break;
+        }
+    }
+}
+
+//Called with the lock held. Takes every buffer back from the threads holding one.
+static void queue_held(Writer* w){
+    for(WriterBuffer* b = w->all; b != NULL; b = b->all){
+        if(!b->held) continue;
+        if(b->len > 0){
+            enqueue(w, b);
+            continue;
+        }
+        b->held = false;
+        b->next = w->free;
+        w->free = b;
+    }
+    w->id = atomic_fetch_add(&next_id, 1);
+}
+
+void flush_writer(Writer* w){
+    pthread_mutex_lock(&w->lock);
+    queue_held(w);
+    while(w->head != NULL || w->writing) pthread_cond_wait(&w->space_cond, &w->lock);
+    pthread_mutex_unlock(&w->lock);
+}
+
+int stop_writer(Writer* w){
+    pthread_mutex_lock(&w->lock);
+    queue_held(w);
+    w->stop = true;
+    pthread_cond_signal(&w->queued_cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    int error = w->error;
+    for(WriterBuffer* b = w->all; b != NULL;){
+        WriterBuffer* next = b->all;
+        free(b->data);
+        free(b);
+        b = next;
+    }
+    pthread_cond_destroy(&w->queued_cond);
+    pthread_cond_destroy(&w->space_cond);
+    pthread_mutex_destroy(&w->lock);
+    free(w);
+
+    if(error != 0){
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,149 @@
+/**
+ *
+ * This file defines the output writer of mdu. Records are streamed while the scan
+ * runs instead of being printed once it is done, so a consumer reading the output
+ * of a large scan starts working right away.
+ *
+ * Every thread formats its records into a buffer of its own, no lock is taken
+ * per record. A full buffer is queued to the writer thread, which writes every
+ * buffer queued at once with one `writev` and returns them for reuse. A thread
+ * queueing a buffer waits while `WRITER_QUEUE` buffers are already queued, so a
+ * slow consumer slows the scan down instead of growing the queue without bound.
+ *
+ * Three formats are written:
+ *   tsv     `blocks<TAB>path<LF>`, as `du` prints.
+ *   ndjson  `{"type":"dir","blocks":N,"path":"..."}` per line, `type` being `file`,
+ *           `dir` or `total`. Quotes, backslashes and control characters in the
+ *           path are escaped, other bytes are written as they are.
+ *   bin     The magic `MDUB`, then per record a `WriterRecord` header in host byte
+ *           order followed by `path_len` bytes of path.
+ *
+ * Records of different threads are interleaved, a record is never split.
+ *
+ * @file writer.h
+ * @author Melker Henriksson
+ * @date 2026/10/16
+ * @brief Buffered output records written by a dedicated thread.
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include "dirref.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#define WRITER_BUFFER_SIZE  (64 * 1024)
+#define WRITER_QUEUE        16
+#define WRITER_IOV          16
+#define WRITER_MAGIC        "MDUB"
+
+typedef enum {
+    FORMAT_TSV,
+    FORMAT_NDJSON,
+    FORMAT_BIN,
+} OutputFormat;
+
+typedef enum {
+    RECORD_FILE,
+    RECORD_DIR,
+    RECORD_TOTAL,
+} RecordType;
+
+typedef struct {
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t path_len;
+    int64_t blocks;
+} WriterRecord;
+
+/**
+ * @note `all` links every buffer of the writer, `next` the queued or free ones.
+ *       `held` is set while the buffer belongs to a thread formatting records.
+ */
+typedef struct WriterBuffer {
+    struct WriterBuffer* next;
+    struct WriterBuffer* all;
+    bool held;
+    size_t len;
+    size_t cap;
+    char* data;
+} WriterBuffer;
+
+/**
+ * @note `queued` counts the buffers in `head`, `writing` is set while the writer
+ *       thread writes buffers it took off the queue.
+ * @note `error` is the `errno` of the first failed write, 0 if none failed. After
+ *       a failure records are dropped.
+ */
+typedef struct {
+    int fd;
+    OutputFormat format;
+    unsigned long id;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t queued_cond;
+    pthread_cond_t space_cond;
+    WriterBuffer* head;
+    WriterBuffer* tail;
+    int queued;
+    bool writing;
+    WriterBuffer* free;
+    WriterBuffer* all;
+    bool stop;
+    int error;
+} Writer;
+
+/**
+ * @brief Starts a writer thread.
+ *
+ * @param fd        Descriptor records are written to, not closed by the writer.
+ * @param format    Format of the records.
+ *
+ * @return The writer, freed with `stop_writer`.
+ */
+Writer* start_writer(int fd, OutputFormat format);
+
+/**
+ * @brief Formats a record into the calling thread's buffer.
+ *
+ * Safe to call from any number of threads at once.
+ *
+ * @param w         Pointer to the writer.
+ * @param type      Type of the record.
+ * @param parent    Directory holding the entry, may be `NULL`.
+ * @param name      Name of the entry, the path is rebuilt as by `build_path`.
+ * @param blocks    Size of the entry in blocks.
+ */
+void write_record(Writer* w, RecordType type, const DirRef* parent, const char* name, long blocks);
+
+/**
+ * @brief Queues the records of every thread and waits until they are written.
+ *
+ * @param w Pointer to the writer.
+ *
+ * @note No other thread may write records while this runs, call it once the
+ *       workers are joined.
+ */
+void flush_writer(Writer* w);
+
+/**
+ * @brief Writes the remaining records, stops the writer thread and frees it.
+ *
+ * @param w Pointer to the writer.
+ *
+ * @return 0 on success, -1 with `errno` set if a write failed.
+ *
+ * @note No other thread may write records while this runs.
+ */
+int stop_writer(Writer* w);
+
+#endif